@@ -6,10 +6,19 @@ import os
 EXPECTED_HEADER = "Datetime,Open,High,Low,Close,Adj Close,Volume,ATR"
 MAX_ROWS = 9000 # Set max rows to keep the data file lean
 
+# With SIGNAL_SHM=<name> set, every ticker's rows also go to the shared-memory feed that
+# `./signal conf.txt --shm=<name>` reads (no CSV parsing on the C++ side).
+feed = None
+if os.environ.get("SIGNAL_SHM"):
+    from shm_feed import FeedWriter
+    with open("conf.txt") as f:
+        pairs = [l.split()[0] for l in (l.split("#")[0].strip() for l in f) if l and not l.startswith(("range ", "rule "))]
+    feed = FeedWriter(os.environ["SIGNAL_SHM"], pairs)
+
 with open("conf.txt") as f:
     for line in f:
         line = line.strip()
-        if not line or line.startswith("#"):
+        if not line or line.startswith(("#", "range ", "rule ")):
             continue
 
         pair = line.split()[0] # Read only the pair from conf.txt
@@ -82,3 +91,9 @@ with open("conf.txt") as f:
 
         print(f"Successfully saved {len(sorted_datetimes)} total candles to '{csv_file}'.")
 
+        if feed:
+            # Same values as the CSV text; bars the feed already has are skipped, the forming one is rewritten.
+            for dt in sorted_datetimes:
+                v = data_map[dt].split(',')
+                feed.publish(pair, v[0], float(v[1]), float(v[2]), float(v[3]), float(v[4]), int(v[6]), float(v[7]))
+
@@ -1,7 +1,7 @@
 import pandas as pd
 
 def read_analysis_config(config_file):
-    """Reads the analyze_conf.txt file to get spread and lot size for each ticker."""
+    """Reads the analyze_conf.txt file to get spread, lot size and (optionally) pip value for each ticker."""
     config = {}
     try:
         with open(config_file, 'r') as f:
@@ -10,9 +10,11 @@ def read_analysis_config(config_file):
                 if not line or line.startswith("#"):
                     continue
                 parts = line.split()
-                if len(parts) == 3:
-                    ticker, spread, lot_size = parts
+                if len(parts) in (3, 4):
+                    ticker, spread, lot_size = parts[:3]
                     config[ticker] = {'spread': float(spread), 'lot_size': float(lot_size)}
+                    if len(parts) == 4:
+                        config[ticker]['pip_value'] = float(parts[3])
     except FileNotFoundError:
         print(f"Warning: Analysis config file '{config_file}' not found. Spreads and lot sizes will be 0.")
     return config
@@ -60,7 +62,7 @@ def analyze_trades(tradelog_file, analysis_config_file):
         config = analysis_config.get(ticker, {'spread': 0.0, 'lot_size': 0.0})
         spread = config['spread']
         lot_size = config['lot_size']
-        point_value = get_point_value(ticker)
+        point_value = config.get('pip_value', get_point_value(ticker))
 
         if lot_size == 0.0:
             print(f"  - Warning: No config found for {ticker}. P/L will be 0.")
@@ -84,6 +86,8 @@ def analyze_trades(tradelog_file, analysis_config_file):
             start_index = entry_index[0]
 
             outcome, pnl, trade_closed = "INCOMPLETE", 0.0, False
+            # Risk-sized trades carry their own lots; older logs (or unsized runs) fall back to the config.
+            lots = trade['Lots'] if 'Lots' in trade and trade['Lots'] > 0 else lot_size
 
             for i in range(start_index + 1, len(price_data)):
                 candle = price_data.iloc[i]
@@ -109,7 +113,7 @@ def analyze_trades(tradelog_file, analysis_config_file):
                         break
 
             # Calculate final P/L in currency
-            pnl = pnl_points * lot_size * point_value
+            pnl = pnl_points * lots * point_value
 
             if not trade_closed:
                 pnl_points_open = 0.0
@@ -118,7 +122,7 @@ def analyze_trades(tradelog_file, analysis_config_file):
                 elif trade['Signal'] == 'SELL':
                     pnl_points_open = (trade['Entry'] - last_close_price) - spread
 
-                pnl = pnl_points_open * lot_size * point_value
+                pnl = pnl_points_open * lots * point_value
                 unclosed_order_pnl += pnl
                 print(f"  - Trade at {trade['Datetime'].strftime('%Y-%m-%d %H:%M')}: {trade['Signal']} -> OPEN | Current PnL: ${pnl:.2f}")
             else:
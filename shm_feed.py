@@ -0,0 +1,72 @@
+# Writer for the signal engine's shared-memory feed (see "Shared-memory feed" in signalv_f.cpp for the
+# layout). Bars go into /dev/shm/<name> as fixed 64-byte records, one ring per ticker, each write wrapped
+# in the ring's seqlock so `./signal conf.txt --shm=<name>` can read them without any CSV in between.
+# Like the C++ side this assumes x86-64: aligned 8-byte stores are atomic and land in program order.
+import calendar
+import mmap
+import os
+import struct
+import time
+
+MAGIC = b"SIGFEED\0"
+VERSION = 1
+HEADER = struct.Struct("<8sIIII40x")      # magic, version, tickers, capacity, record size
+RING = struct.Struct("<40sQQ8x")          # ticker, seq, count
+RECORD = struct.Struct("<qddddqdq")       # timestamp, open, high, low, close, volume, atr, published_ns
+SEQ_OFFSET, COUNT_OFFSET = 40, 48
+
+
+class FeedWriter:
+    """Opens /dev/shm/<name> if it already holds exactly these tickers and this capacity (so a reader
+    keeps its history across fetch cycles), otherwise creates it afresh."""
+
+    def __init__(self, name, tickers, capacity=16384):
+        self.tickers = list(tickers)
+        self.capacity = capacity
+        self.ring_bytes = RING.size + capacity * RECORD.size
+        size = HEADER.size + len(self.tickers) * self.ring_bytes
+        path = "/dev/shm/" + name
+        fd = os.open(path, os.O_RDWR | os.O_CREAT, 0o644)
+        try:
+            fresh = os.fstat(fd).st_size != size
+            if fresh:
+                os.ftruncate(fd, 0)
+                os.ftruncate(fd, size)
+            self.mem = mmap.mmap(fd, size)
+        finally:
+            os.close(fd)
+        if not fresh:
+            magic, version, count, capacity_found, record_size = HEADER.unpack_from(self.mem, 0)
+            names = [RING.unpack_from(self.mem, self._ring(k))[0].rstrip(b"\0").decode() for k in range(count)]
+            fresh = (magic, version, capacity_found, record_size, names) != (MAGIC, VERSION, capacity, RECORD.size, self.tickers)
+            if fresh:
+                self.mem[:] = bytes(size)
+        if fresh:
+            for k, ticker in enumerate(self.tickers):
+                RING.pack_into(self.mem, self._ring(k), ticker.encode()[:39], 0, 0)
+            HEADER.pack_into(self.mem, 0, b"\0" * 8, VERSION, len(self.tickers), capacity, RECORD.size)
+            self.mem[0:8] = MAGIC  # last, like the C++ writer
+
+    def _ring(self, k):
+        return HEADER.size + k * self.ring_bytes
+
+    def publish(self, ticker, datetime_str, open_, high, low, close, volume, atr):
+        """Appends a bar ("YYYY-MM-DD HH:MM:SS", UTC), or rewrites the newest one if it has the same time.
+        Returns False for a bar older than the newest."""
+        ring = self._ring(self.tickers.index(ticker))
+        timestamp = calendar.timegm(time.strptime(datetime_str, "%Y-%m-%d %H:%M:%S"))
+        seq, count = struct.unpack_from("<QQ", self.mem, ring + SEQ_OFFSET)
+        records = ring + RING.size
+        newest = RECORD.unpack_from(self.mem, records + (count - 1) % self.capacity * RECORD.size)[0] if count else None
+        if newest is not None and timestamp < newest:
+            return False
+        slot = count - 1 if timestamp == newest else count
+        struct.pack_into("<Q", self.mem, ring + SEQ_OFFSET, seq + 1)
+        RECORD.pack_into(self.mem, records + slot % self.capacity * RECORD.size,
+                         timestamp, open_, high, low, close, volume, atr, time.monotonic_ns())
+        struct.pack_into("<Q", self.mem, ring + COUNT_OFFSET, slot + 1)
+        struct.pack_into("<Q", self.mem, ring + SEQ_OFFSET, seq + 2)
+        return True
+
+    def close(self):
+        self.mem.close()
@@ -0,0 +1,324 @@
+// Microbenchmarks for the signal engine. Builds against the same source as ./signal:
+//   g++ -std=c++17 -O2 -pthread -o signal_bench signal_bench.cpp
+//   ./signal_bench [--bars=1000,10000,100000,1000000] [--periods=14,50,200] [--json]
+#define SIGNAL_NO_MAIN
+#include "signalv_f.cpp"
+
+#include <chrono>
+#include <ctime>
+
+// --- Synthetic Data ---
+std::vector<Candle> syntheticCandles(size_t n, bool with_volume, uint64_t seed) {
+    std::vector<Candle> candles(n);
+    double price = 1.1, prev_close = price;
+    double tr_sum = 0;
+    std::vector<double> trs;
+    for (size_t i = 0; i < n; ++i) {
+        double u = (counterRandom(seed, 0, i) >> 11) * (1.0 / 9007199254740992.0);
+        double w = (counterRandom(seed, 1, i) >> 11) * (1.0 / 9007199254740992.0);
+        double close = price * (1.0 + (u - 0.5) * 0.004);
+        Candle& c = candles[i];
+        c.datetime = "";
+        c.open = price;
+        c.close = close;
+        c.high = std::max(price, close) * (1.0 + w * 0.001);
+        c.low = std::min(price, close) * (1.0 - w * 0.001);
+        c.volume = with_volume ? 100 + (long long)(w * 10000) : 0;
+        double tr = std::max({c.high - c.low, std::fabs(c.high - prev_close), std::fabs(c.low - prev_close)});
+        trs.push_back(tr);
+        tr_sum += tr;
+        if (trs.size() > 14) tr_sum -= trs[trs.size() - 15];
+        c.atr = tr_sum / std::min<size_t>(trs.size(), 14);
+        prev_close = close;
+        price = close;
+    }
+    return candles;
+}
+
+// --- Results ---
+// Every measurement is also kept here for --json. A figure that does not apply to a benchmark is NaN
+// and comes out as null.
+struct BenchResult { std::string bench; std::string variant; size_t bars; int period; double ns_per_bar; double trials_per_sec; double mb_per_sec; };
+std::vector<BenchResult> results;
+const double NA = std::numeric_limits<double>::quiet_NaN();
+void record(const std::string& bench, const std::string& variant, size_t bars, int period, double ns_per_bar, double trials_per_sec, double mb_per_sec) {
+    results.push_back({bench, variant, bars, period, ns_per_bar, trials_per_sec, mb_per_sec});
+}
+void writeJson(std::ostream& out) {
+    auto number = [&out](double v) {
+        if (std::isnan(v)) out << "null"; else out << v;
+    };
+    out << std::setprecision(6) << std::defaultfloat << "{\"cores\": " << std::thread::hardware_concurrency() << ", \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << (i ? ",\n  " : "\n  ") << "{\"bench\": \"" << r.bench << "\", \"variant\": \"" << r.variant << "\", \"bars\": " << r.bars << ", \"period\": ";
+        if (r.period) out << r.period; else out << "null";
+        out << ", \"ns_per_bar\": ";
+        number(r.ns_per_bar);
+        out << ", \"trials_per_sec\": ";
+        number(r.trials_per_sec);
+        out << ", \"mb_per_sec\": ";
+        number(r.mb_per_sec);
+        out << "}";
+    }
+    out << "\n]}" << std::endl;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<StrategyParams> sampleTrials(StrategyKind kind, int n_trials) {
+    auto space = strategyParamSpace(kind);
+    std::vector<StrategyParams> trials;
+    for (int t = 0; t < n_trials; ++t) {
+        std::vector<double> x(space.size());
+        for (size_t d = 0; d < x.size(); ++d) x[d] = (counterRandom(11, t, d) >> 11) * (1.0 / 9007199254740992.0);
+        trials.push_back(decodeParams(space, x, kind));
+    }
+    return trials;
+}
+
+// --- Benchmarks ---
+// The fused SMA/RSI/OBV kernel on data with and without volume (the OBV check compiled in or out).
+void benchKernels(size_t n_bars, int n_trials, bool with_volume) {
+    SeriesCache cache = buildSeriesCache(syntheticCandles(n_bars, with_volume, 7));
+    std::vector<StrategyParams> trials = sampleTrials(StrategyKind::SmaRsiObv, n_trials);
+
+    double check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& p : trials)
+        check += with_volume ? backtestKernel<true>(cache, p, 0, n_bars, nullptr, nullptr).profit
+                             : backtestKernel<false>(cache, p, 0, n_bars, nullptr, nullptr).profit;
+    double secs = secondsSince(start);
+
+    double bars = (double)n_bars * n_trials;
+    record("backtestKernel", with_volume ? "volume" : "no_volume", n_bars, 0, secs * 1e9 / bars, n_trials / secs, NA);
+    std::cout << std::fixed << std::setprecision(3)
+              << "kernel bars=" << n_bars << " trials=" << n_trials << " volume=" << with_volume
+              << " | " << secs * 1e9 / bars << " ns/bar, " << std::setprecision(0) << n_trials / secs << " trials/s"
+              << (std::isnan(check) ? " (nan)" : "") << std::endl;
+}
+
+// Per-bar cost of each strategy through simulateBacktestRange.
+void benchStrategies(size_t n_bars, int n_trials) {
+    SeriesCache cache = buildSeriesCache(syntheticCandles(n_bars, true, 7));
+    const std::pair<const char*, StrategyKind> kinds[] = { {"sma_rsi", StrategyKind::SmaRsiObv}, {"breakout", StrategyKind::Breakout}, {"meanrev", StrategyKind::MeanReversion} };
+    std::cout << std::fixed << std::setprecision(3) << "strategies bars=" << n_bars << " trials=" << n_trials;
+    for (const auto& k : kinds) {
+        std::vector<StrategyParams> trials = sampleTrials(k.second, n_trials);
+        double check = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& p : trials) check += simulateBacktestRange(cache, p, 0, n_bars).profit;
+        double secs = secondsSince(start);
+        record("simulateBacktestRange", k.first, n_bars, 0, secs * 1e9 / ((double)n_bars * n_trials), n_trials / secs, NA);
+        std::cout << " | " << k.first << " " << secs * 1e9 / ((double)n_bars * n_trials) << " ns/bar";
+        if (std::isnan(check)) std::cout << " (nan)";
+    }
+    std::cout << std::endl;
+}
+
+// The per-bar indicator helpers the live signal uses, evaluated at every bar of the series (SMA, RSI) or
+// over the newest `period` bars repeatedly (OBV direction, which only looks at the tail). ns/bar is per
+// bar the function reads, so it should stay flat as the period grows.
+void benchIndicators(size_t n_bars, int period) {
+    if (n_bars <= (size_t)period + 1) return;
+    std::vector<Candle> candles = syntheticCandles(n_bars, true, 7);
+    std::vector<double> closes(n_bars);
+    for (size_t i = 0; i < n_bars; ++i) closes[i] = candles[i].close;
+    size_t calls = n_bars - period;
+    double check = 0;
+    std::cout << std::fixed << std::setprecision(3) << "indicators bars=" << n_bars << " period=" << period;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = period; i < n_bars; ++i) check += computeSMA(closes, i, period);
+    double secs = secondsSince(start);
+    record("computeSMA", "", n_bars, period, secs * 1e9 / ((double)calls * period), NA, NA);
+    std::cout << " | sma " << secs * 1e9 / ((double)calls * period) << " ns/bar";
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = period; i < n_bars; ++i) check += computeRSI(closes, i, period);
+    secs = secondsSince(start);
+    record("computeRSI", "", n_bars, period, secs * 1e9 / ((double)calls * period), NA, NA);
+    std::cout << " | rsi " << secs * 1e9 / ((double)calls * period) << " ns/bar";
+
+    size_t repeats = std::max<size_t>(1, n_bars / period);
+    start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < repeats; ++r) check += computeOBVDirection(candles, period);
+    secs = secondsSince(start);
+    record("computeOBVDirection", "", n_bars, period, secs * 1e9 / ((double)repeats * period), NA, NA);
+    std::cout << " | obv " << secs * 1e9 / ((double)repeats * period) << " ns/bar";
+    if (std::isnan(check)) std::cout << " (nan)";
+    std::cout << std::endl;
+}
+
+// simulateBacktest on plain candles (rebuilds the series cache every call, as its callers pay) and the
+// random-search optimiser over a prepared cache, both on the default SMA/RSI/OBV strategy.
+void benchBacktest(size_t n_bars, int n_trials) {
+    std::vector<Candle> candles = syntheticCandles(n_bars, true, 7);
+    std::vector<StrategyParams> trials = sampleTrials(StrategyKind::SmaRsiObv, n_trials);
+    double check = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto& p : trials) check += simulateBacktest(candles, p);
+    double secs = secondsSince(start);
+    double bars = (double)n_bars * n_trials;
+    record("simulateBacktest", "candles", n_bars, 0, secs * 1e9 / bars, n_trials / secs, NA);
+    std::cout << std::fixed << std::setprecision(3) << "backtest bars=" << n_bars << " trials=" << n_trials
+              << " | simulateBacktest " << secs * 1e9 / bars << " ns/bar, " << std::setprecision(0) << n_trials / secs << " trials/s";
+
+    SeriesCache cache = buildSeriesCache(candles);
+    Objective objective;
+    start = std::chrono::steady_clock::now();
+    StrategyParams best = findBestParameters_Random(cache, 0, n_bars, strategyParamSpace(StrategyKind::SmaRsiObv), n_trials, objective);
+    secs = secondsSince(start);
+    record("findBestParameters_Random", "profit", n_bars, 0, secs * 1e9 / bars, n_trials / secs, NA);
+    std::cout << std::setprecision(3) << " | findBestParameters_Random " << secs * 1e9 / bars << " ns/bar, " << std::setprecision(0) << n_trials / secs << " trials/s";
+    if (std::isnan(check) || std::isnan(best.performance)) std::cout << " (nan)";
+    std::cout << std::endl;
+}
+
+// A synthetic 5-minute CSV in the fetch script's layout; returns its name.
+std::string writeSyntheticCsv(size_t n_rows) {
+    std::string file = "signal_bench_" + std::to_string(n_rows) + ".csv";
+    std::vector<Candle> candles = syntheticCandles(n_rows, true, 7);
+    std::ofstream out(file);
+    out << "Datetime,Open,High,Low,Close,Adj Close,Volume,ATR\n" << std::fixed << std::setprecision(6);
+    char stamp[32];
+    for (size_t i = 0; i < n_rows; ++i) {
+        time_t t = 1420070400 + 300 * (time_t)i;
+        std::tm tm_utc;
+        gmtime_r(&t, &tm_utc);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm_utc);
+        const Candle& c = candles[i];
+        out << stamp << "," << c.open << "," << c.high << "," << c.low << "," << c.close << "," << c.close << "," << c.volume << "," << c.atr << "\n";
+    }
+    return file;
+}
+double fileMegabytes(const std::string& file) {
+    std::ifstream sized(file, std::ios::binary | std::ios::ate);
+    return sized.tellg() / 1e6;
+}
+
+// readData throughput on the synthetic CSV: one parsing thread vs one per core (identical rows either way).
+void benchCsvParse(size_t n_rows) {
+    std::string file = writeSyntheticCsv(n_rows);
+    double mb = fileMegabytes(file);
+    std::cout << std::fixed << std::setprecision(1) << "csv rows=" << n_rows << " size=" << mb << "MB";
+    size_t rows_single = 0;
+    for (size_t threads : {(size_t)1, (size_t)0}) {
+        auto start = std::chrono::steady_clock::now();
+        size_t rows = readData(file, nullptr, threads).size();
+        double secs = secondsSince(start);
+        if (threads == 1) rows_single = rows;
+        record("readData", threads ? "csv/1_thread" : "csv/all_cores", n_rows, 0, secs * 1e9 / rows, NA, mb / secs);
+        std::cout << " | " << (threads ? "1 thread " : "all cores ") << mb / secs << " MB/s (" << rows / secs / 1e6 << "M rows/s)";
+        if (rows != n_rows || rows != rows_single) std::cout << " ROWS DIFFER";
+    }
+    std::cout << " | cores=" << std::thread::hardware_concurrency() << std::endl;
+    std::remove(file.c_str());
+}
+
+// The same rows from a .scol archive: size against the CSV and load time against parsing the CSV, with
+// one decoding thread and one per core. Rows are checked bit for bit against the CSV's.
+void benchColumnar(size_t n_rows) {
+    std::string csv = writeSyntheticCsv(n_rows), scol = "signal_bench_" + std::to_string(n_rows) + ".scol";
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Candle> expected = readData(csv, nullptr, 1);
+    double csv_secs = secondsSince(start);
+    start = std::chrono::steady_clock::now();
+    writeColumnar(scol, expected);
+    double encode_secs = secondsSince(start);
+    std::cout << std::fixed << std::setprecision(1) << "scol rows=" << n_rows << " size=" << fileMegabytes(scol) << "MB ("
+              << fileMegabytes(csv) / fileMegabytes(scol) << "x smaller) encode " << n_rows / encode_secs / 1e6 << "M rows/s";
+    for (size_t threads : {(size_t)1, (size_t)0}) {
+        start = std::chrono::steady_clock::now();
+        std::vector<Candle> rows = readData(scol, nullptr, threads);
+        double secs = secondsSince(start);
+        record("readData", threads ? "scol/1_thread" : "scol/all_cores", n_rows, 0, secs * 1e9 / rows.size(), NA, fileMegabytes(scol) / secs);
+        std::cout << " | " << (threads ? "1 thread " : "all cores ") << rows.size() / secs / 1e6 << "M rows/s";
+        if (threads) std::cout << " (" << csv_secs / secs << "x the CSV)";
+        bool same = rows.size() == expected.size();
+        for (size_t i = 0; same && i < rows.size(); ++i)
+            same = rows[i].datetime == expected[i].datetime && rows[i].close == expected[i].close && rows[i].open == expected[i].open
+                && rows[i].high == expected[i].high && rows[i].low == expected[i].low && rows[i].volume == expected[i].volume && rows[i].atr == expected[i].atr;
+        if (!same) std::cout << " ROWS DIFFER";
+    }
+    std::cout << std::endl;
+    std::remove(csv.c_str());
+    std::remove(scol.c_str());
+}
+
+// Tick-to-bar aggregation on one core: a random walk of ticks 50-450ms apart, into one interval and
+// into six at once (1m to 1d). Ticks are generated up front so only aggregateTick is timed.
+void benchTickAggregation(size_t n_ticks) {
+    std::vector<int64_t> times(n_ticks);
+    std::vector<double> prices(n_ticks);
+    std::vector<long long> sizes(n_ticks);
+    int64_t t = 1700000000000;
+    double price = 1.1;
+    for (size_t i = 0; i < n_ticks; ++i) {
+        uint64_t r = counterRandom(5, 0, i);
+        t += 50 + (int64_t)(r % 400);
+        price *= 1.0 + ((r >> 11) * (1.0 / 9007199254740992.0) - 0.5) * 2e-4;
+        times[i] = t;
+        prices[i] = price;
+        sizes[i] = 1 + (long long)((r >> 20) % 1000);
+    }
+    std::cout << std::fixed << std::setprecision(1) << "ticks=" << n_ticks;
+    for (const std::vector<int64_t>& periods : {std::vector<int64_t>{300}, std::vector<int64_t>{60, 300, 900, 3600, 14400, 86400}}) {
+        TickAggregator agg = makeTickAggregator(periods);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < n_ticks; ++i) aggregateTick(agg, times[i], prices[i], sizes[i]);
+        flushTicks(agg);
+        double secs = secondsSince(start);
+        size_t bars = 0;
+        for (const auto& f : agg.frames) bars += f.out.timestamp.size();
+        record("aggregateTick", std::to_string(periods.size()) + "_intervals", n_ticks, 0, secs * 1e9 / n_ticks, NA, NA);
+        std::cout << " | " << periods.size() << (periods.size() == 1 ? " interval " : " intervals ") << n_ticks / secs / 1e6 << "M ticks/s ("
+                  << std::setprecision(2) << secs * 1e9 / n_ticks << "ns/tick, " << bars << " bars)" << std::setprecision(1);
+    }
+    std::cout << std::endl;
+}
+
+std::vector<size_t> parseSizeList(const std::string& text) {
+    std::vector<size_t> values;
+    std::stringstream list(text);
+    for (std::string item; getline(list, item, ',');) values.push_back(std::stoul(item));
+    return values;
+}
+
+// Series lengths and indicator periods come from the command line; 10M bars needs a few GB of memory and
+// disk for the synthetic CSV. With --json the usual report goes to stderr and stdout gets one JSON object
+// with every measurement, for tracking over time.
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000}, periods = {14, 50, 200};
+    bool json = false;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--json") json = true;
+            else if (arg.rfind("--bars=", 0) == 0) sizes = parseSizeList(arg.substr(7));
+            else if (arg.rfind("--periods=", 0) == 0) periods = parseSizeList(arg.substr(10));
+            else throw std::invalid_argument(arg);
+        }
+    } catch (const std::exception&) {
+        std::cerr << "Usage: " << argv[0] << " [--bars=1000,10000,100000,1000000] [--periods=14,50,200] [--json]" << std::endl;
+        return 1;
+    }
+    std::streambuf* stdout_buf = std::cout.rdbuf();
+    if (json) std::cout.rdbuf(std::cerr.rdbuf());
+    for (size_t n : sizes) {
+        int trials = (int)std::max<size_t>(20, 20000000 / n);
+        for (size_t period : periods) benchIndicators(n, (int)period);
+        benchKernels(n, trials, false);
+        benchKernels(n, trials, true);
+        benchStrategies(n, trials);
+        benchBacktest(n, trials);
+        benchCsvParse(n);
+        benchColumnar(n);
+        benchTickAggregation(n * 10);
+    }
+    std::cout.rdbuf(stdout_buf);
+    if (json) writeJson(std::cout);
+    return 0;
+}
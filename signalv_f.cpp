@@ -10,23 +10,280 @@
 #include <algorithm>
 #include <random>
 #include <thread>
+#include <functional>
+#include <atomic>
+#include <map>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <array>
+#include <chrono>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <charconv>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // --- Structs ---
-struct PairConfig { std::string ticker; std::string interval;};
-struct Candle { std::string datetime; double open; double high; double low; double close; long long volume; double atr; };
-struct StrategyParams { int sma_short = 5; int sma_long = 20; int rsi_period = 14; double performance = -1e9; };
+struct ParamRange { std::string name; double lo; double hi; bool integer; };
+struct PairConfig {
+    std::string ticker; std::string interval;
+    int iterations = 0; std::string optimizer; std::string objective; int priority = 0; std::vector<ParamRange> ranges;  // 0 / empty = global setting
+};
+struct Candle { std::string datetime; double open; double high; double low; double close; long long volume; double atr; int64_t timestamp = -1; };
+struct SeriesStats {
+    size_t rows = 0; std::map<std::string, size_t> rejected;  // data rows read; reason -> rows dropped
+    bool has_volume = false; size_t untimestamped = 0; size_t out_of_order = 0; size_t duplicates = 0; bool sorted = false;
+    int64_t step = 0; size_t gaps = 0;  // step is set by the caller (the bar interval); 0 skips gap counting
+    double min_price = INFINITY; double max_price = -INFINITY; int64_t first_time = -1; int64_t last_time = -1;
+};
+struct CsvChunk {
+    const char* begin = nullptr; const char* end = nullptr;  // whole lines of the file buffer
+    std::vector<Candle> candles; SeriesStats stats; bool repeated = false;
+    int64_t first_time = INT64_MIN; int64_t last_time = INT64_MIN;  // first/last timestamped row, for checks across the seam
+};
+struct CsvStream {
+    std::ifstream file; std::string buffer; size_t pos = 0;  // buffer[pos..] is read but not yet parsed
+    SeriesStats stats; int64_t last_time = INT64_MIN; bool repeated = false;
+};
+enum class ColumnEncoding : uint8_t { Timestamp, Scaled, Gorilla, Varint };
+struct BitWriter { std::string bytes; uint64_t acc = 0; int bits = 0; };  // LSB-first; acc holds the bits not yet in bytes
+struct FeedHeader {
+    char magic[8]; uint32_t version; uint32_t tickers; uint32_t capacity; uint32_t record_size;
+    std::atomic<uint32_t> followers; std::atomic<uint32_t> closed; char reserved[32];  // live readers attached; set once the producer is done
+};
+struct FeedRingHeader { char ticker[40]; std::atomic<uint64_t> seq; std::atomic<uint64_t> count; uint64_t reserved; };
+struct FeedRecord { int64_t timestamp; double open; double high; double low; double close; int64_t volume; double atr; int64_t published_ns; };  // published_ns: steady clock at publish
+static_assert(sizeof(FeedHeader) == 64 && sizeof(FeedRingHeader) == 64 && sizeof(FeedRecord) == 64, "shared memory layout is fixed");
+struct FeedSegment { std::string name; uint8_t* base = nullptr; size_t bytes = 0; uint32_t tickers = 0; uint32_t capacity = 0; };
+struct CandleColumns { std::vector<int64_t> timestamp; std::vector<double> open, high, low, close, atr; std::vector<long long> volume; };
+struct BarFrame {  // one interval of one ticker's tick aggregation
+    int64_t period_ms = 0; int64_t start = INT64_MIN; int64_t end = INT64_MIN;  // bar being built: [start, end) in ms
+    double open = 0; double high = 0; double low = 0; double close = 0; long long volume = 0; bool forming = false;
+    double prev_close = NAN; std::array<double, 14> tr{}; size_t bars = 0;  // true ranges of the last 14 closed bars
+    CandleColumns out;  // closed bars with an ATR
+};
+struct TickAggregator { std::vector<BarFrame> frames; size_t ticks = 0; size_t late = 0; };
+struct LatencyHistogram { std::array<uint64_t, 1024> counts{}; uint64_t total = 0; int64_t max_ns = 0; };
+enum class StrategyKind : uint8_t { SmaRsiObv, Breakout, MeanReversion };
+struct StrategyParams {
+    StrategyKind strategy = StrategyKind::SmaRsiObv;
+    int sma_short = 5; int sma_long = 20; int rsi_period = 14; double sl_atr = 1.5; double tp_atr = 2.0; int obv_period = 14;
+    double min_atr_percent = 0.10; double rsi_threshold = 50; int channel_period = 20; double band_k = 2.0; double performance = -1e9;
+};
+struct TickerJob { size_t index; size_t rows; int iterations; double estimate; double seconds; };
+struct SeriesCache {
+    std::vector<double> closes; std::vector<double> highs; std::vector<double> lows; std::vector<double> atr; std::vector<float> atr_percent;
+    std::vector<double> close_sum; std::vector<double> gain_sum; std::vector<double> loss_sum; std::vector<long long> obv; bool has_volume = false;
+    double center = 0; std::vector<double> centered_sq_sum;  // prefix sums of (close - center)^2, for rolling variance
+    std::vector<int64_t> timestamps;
+    std::vector<int8_t> htf_trend;  // per bar: higher-timeframe trend (+1/0/-1) as of the last closed HTF bar; empty = no confirmation
+    std::vector<double> risk_lots;  // per bar: lots that lose the risk budget on a 1xATR stop; empty = unsized (1 unit, PnL in price)
+    double pip_value = 0; double lot_step = 0;
+};
+struct InstrumentSpec { double spread = 0; double lot_step = 0; double pip_value = 0; };  // pip_value: account currency per 1.0 price move per lot
+struct ResampledSeries {
+    std::string interval; int64_t period = 0;
+    std::vector<int64_t> start; std::vector<double> open; std::vector<double> high; std::vector<double> low; std::vector<double> close;
+    std::vector<long long> volume; std::vector<double> atr;
+    std::vector<double> tr_sum;        // prefix sums of true range (one longer than the bars)
+    std::vector<uint32_t> bucket_of;   // base bar -> resampled bar that contains it
+};
+struct BacktestMetrics {
+    bool valid = false; double profit = 0; int trades = 0; int wins = 0; double gross_profit = 0; double gross_loss = 0;
+    size_t bars = 0; size_t exposure_bars = 0; double ret_sum = 0; double ret_sq_sum = 0; double down_sq_sum = 0; double max_drawdown = 0;
+};
+struct BacktestState {  // everything runBacktestBars carries from one bar to the next
+    BacktestMetrics m; double profit = 0.0; double peak = 0.0; bool in_pos = false; double entry = 0.0; double sl = 0.0; double tp = 0.0; double units = 1.0;
+};
+struct StreamSettings { size_t block_rows = 100000; bool has_volume = false; double risk_cash = 0; InstrumentSpec spec; };
+struct StreamReport { size_t rows = 0; size_t peak_bars = 0; SeriesStats stats; };
+struct WalkForwardFold { size_t train_begin; size_t test_begin; size_t test_end; StrategyParams params; double in_sample; double out_of_sample; };
+struct WalkForwardResult { std::vector<WalkForwardFold> folds; std::vector<double> equity; };
+struct MonteCarloSummary { int resamples = 0; size_t trades = 0; double pnl_p5 = 0, pnl_p50 = 0, pnl_p95 = 0; double dd_p50 = 0, dd_p95 = 0, dd_p99 = 0; };
+enum class RuleOp : uint8_t { Const, Load, Add, Sub, Mul, Div, Neg, Not, Compare, JumpIfFalse, JumpIfTrue, LoadCmpLoad, LoadCmpConst };
+enum class RuleSeries : uint8_t { Sma, Rsi, Obv, Close, Atr, AtrPercent };
+enum class RuleCmp : uint8_t { Gt, Lt, Ge, Le, Eq, Ne };
+struct RuleInstr { RuleOp op; RuleCmp cmp = RuleCmp::Gt; RuleSeries lhs = RuleSeries::Close; int lhs_period = 0; RuleSeries rhs = RuleSeries::Close; int rhs_period = 0; double k = 0; int jump = 0; };
+struct RuleProgram { std::vector<RuleInstr> code; int max_period = 0; };
+struct LiveRules { RuleProgram buy; RuleProgram sell; bool has_volume = false; };  // buy/sell compiled for one ticker's params
+struct LiveTicker {  // one ticker followed by followFeed
+    size_t run = 0; int ring = 0; uint64_t cursor = 0; FeedRecord last{};  // cursor: feed records consumed; last: the newest one as read
+    LatencyHistogram latency; size_t bars = 0; size_t lost = 0; size_t keep = 0;
+    int direction = 0;  // tradable signal on the newest bar (+1 BUY, -1 SELL), for the correlation filter
+    LiveRules programs;
+};
+struct RuleNode { std::string kind; std::string name; double value = 0; std::vector<RuleNode> args; };
+struct RuleSet {
+    bool custom = false;
+    std::string buy_text = "sma(s) > sma(l) && rsi(r) > t && obv(o) == 1";
+    std::string sell_text = "sma(s) < sma(l) && rsi(r) < 100 - t && obv(o) == -1";
+    std::string exit_text = "sma(s) < sma(l)";
+    RuleNode buy; RuleNode sell; RuleNode exit;
+};
+struct ParetoPoint { StrategyParams params; double profit; double max_drawdown; int trades; };
+struct ParetoFront { std::mutex mtx; std::vector<ParetoPoint> points; };
+struct WorkerPool {  // threads shared by every parallelFor, started on first use
+    std::mutex caller;  // held by the one parallelFor using the pool
+    std::mutex mtx; std::condition_variable wake; std::condition_variable done;
+    const std::function<void(size_t)>* body = nullptr; size_t count = 0; std::atomic<size_t> next{0};
+    uint64_t generation = 0; size_t busy = 0; std::vector<std::thread> threads;
+};
+struct Objective { std::string metric = "profit"; ParetoFront* pareto = nullptr; const RuleSet* rules = nullptr; StrategyKind strategy = StrategyKind::SmaRsiObv; };
+struct TickerRun {
+    bool ok = false; std::string ticker; SeriesCache cache; StrategyParams params;
+    std::string signal = "HOLD"; std::string datetime; double entry = 0; double sl = 0; double tp = 0; double lots = 0;  // live signal, logged once all tickers are in
+    uint64_t feed_cursor = 0;  // with --shm: feed records the cache was built from
+};
+struct RollingCorrelation {
+    size_t tickers = 0; size_t window = 0; size_t count = 0; size_t head = 0; size_t since_rebuild = 0;
+    std::vector<double> ring;  // window x tickers returns, oldest at head once full
+    std::vector<double> sum;   // per ticker
+    std::vector<double> prod;  // tickers x tickers sums of products
+};
+struct PortfolioSummary {
+    size_t steps = 0; double start_equity = 0; double end_equity = 0; double max_drawdown = 0; int trades = 0;
+    int peak_positions = 0; double peak_margin = 0; int refused = 0;
+};
+struct GenerationStats { int generation; double best; double mean; };
+struct HalvingSchedule { size_t min_bars = 500; double eta = 3.0; };
+struct RunOptions { std::string optimizer = "random"; std::string objective = "profit"; int iterations = 100; HalvingSchedule halving; bool walk_forward = false; size_t wf_train = 3000; size_t wf_test = 500; int monte_carlo = 0; uint64_t mc_seed = 42; std::string pareto = "off"; std::vector<ParamRange> space; RuleSet rules; StrategyKind strategy = StrategyKind::SmaRsiObv;
+    std::string confirm = "off"; int confirm_sma = 20; int jobs = 0; double portfolio = 0; double leverage = 10;
+    double corr_filter = 0; size_t corr_window = 288;
+    double risk_percent = 0; double account = 10000; InstrumentSpec instrument;
+    size_t stream_rows = 0; size_t stream_tail = 9000; std::string shm; bool live = false; };
 
 // --- Forward Declarations for clarity ---
-std::vector<PairConfig> readConfig(const std::string& file);
-std::vector<Candle> readData(const std::string& file);
-bool hasVolumeData(const std::vector<Candle>& candles);
-void logTrade(const std::string& datetime, const std::string& ticker, const std::string& signal, double entry, double sl, double tp);
+bool readConfig(const std::string& file, std::vector<PairConfig>& cfgs);
+bool tickerOptions(const RunOptions& base, const PairConfig& cfg, RunOptions& out);
+bool validOptimizer(const std::string& name);
+bool validObjective(const std::string& name);
+size_t countRows(const std::string& file);
+std::map<std::string, double> readTimings(const std::string& file);
+void writeTimings(const std::string& file, const std::map<std::string, double>& per_unit);
+std::map<std::string, InstrumentSpec> readInstrumentSpecs(const std::string& file);
+bool readParamSpace(const std::string& file, std::vector<ParamRange>& space);
+bool readRuleSet(const std::string& file, RuleSet& rules);
+RuleNode parseRule(const std::string& text);
+RuleProgram compileRule(const RuleNode& node, const StrategyParams& params, bool has_volume);
+double evalRule(const RuleProgram& prog, const SeriesCache& cache, size_t i);
+std::vector<Candle> readData(const std::string& file, SeriesStats* stats = nullptr, size_t threads = 0);
+void parseCsvChunk(CsvChunk& chunk, int64_t step);
+void addRowStats(CsvChunk& chunk, const Candle& candle, int64_t& last_time, int64_t step);
+void mergeChunkStats(SeriesStats& st, const CsvChunk& chunk, int64_t& last_time, bool& repeated);
+bool openCsvStream(CsvStream& in, const std::string& file, int64_t step);
+bool readCsvBlock(CsvStream& in, size_t rows, std::vector<Candle>& out);
+std::vector<Candle> streamTail(const std::string& file, size_t tail, size_t block_rows, SeriesStats* stats);
+bool csvNumber(const char* s, size_t n, double& out);
+bool csvNumber(const char* s, size_t n, long long& out);
+bool csvNumber(const std::string& s, double& out);
+bool csvNumber(const std::string& s, long long& out);
+void sortByTimestamp(std::vector<Candle>& candles);
+int64_t parseTimestamp(const std::string& datetime);
+void formatTimestamp(int64_t ts, char* out, int64_t& cached_day);
+bool isColumnarFile(const std::string& file);
+std::string tickerDataFile(const std::string& ticker);
+uint64_t zigzag(int64_t v);
+int64_t unzigzag(uint64_t v);
+void putVarint(std::string& out, uint64_t v);
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v);
+void putBits(BitWriter& w, uint64_t v, int n);
+void putWideBits(BitWriter& w, uint64_t v, int n);
+void finishBits(BitWriter& w);
+uint64_t readBits(const uint8_t* data, size_t bit, int n);
+uint64_t readWideBits(const uint8_t* data, size_t& bit, int n);
+void putPfor(std::string& out, const std::vector<uint64_t>& values);
+bool getPfor(const uint8_t*& p, const uint8_t* end, size_t n, uint64_t* values);
+int scaledDigits(const double* x, size_t n);
+void putDoubleColumn(std::string& out, const std::vector<double>& x);
+bool getDoubleColumn(const uint8_t* p, const uint8_t* end, uint8_t encoding, size_t n, double* x);
+std::string encodeColumnarBlock(const Candle* rows, size_t n);
+bool decodeColumnarBlock(const uint8_t* p, const uint8_t* end, CsvChunk& chunk, int64_t step);
+bool readColumnar(const std::string& data, std::vector<CsvChunk>& chunks, int64_t step, size_t threads);
+bool writeColumnar(const std::string& path, const std::vector<Candle>& candles);
+int compressCommand(int argc, char* argv[]);
+bool createFeed(FeedSegment& seg, const std::string& name, const std::vector<std::string>& tickers, uint32_t capacity);
+bool openFeed(FeedSegment& seg, const std::string& name, bool writable = false);
+void closeFeed(FeedSegment& seg);
+FeedRingHeader* feedRing(const FeedSegment& seg, size_t ring);
+FeedRecord* feedRecords(const FeedSegment& seg, size_t ring);
+int feedRingIndex(const FeedSegment& seg, const std::string& ticker);
+bool feedPublish(FeedSegment& seg, size_t ring, const FeedRecord& rec);
+uint64_t feedRead(const FeedSegment& seg, size_t ring, uint64_t from, size_t max_records, std::vector<FeedRecord>& out, uint64_t& first);
+size_t feedRows(const std::string& name, const std::string& ticker);
+std::vector<Candle> readFeed(const std::string& name, const std::string& ticker, SeriesStats* stats, uint64_t* next = nullptr);
+int replayCommand(int argc, char* argv[]);
+void latencyRecord(LatencyHistogram& h, int64_t ns);
+int64_t latencyPercentile(const LatencyHistogram& h, double p);
+void followFeed(std::vector<TickerRun>& runs, const std::vector<RunOptions>& ticker_opts, const RunOptions& opts);
+TickAggregator makeTickAggregator(const std::vector<int64_t>& periods);
+void aggregateTick(TickAggregator& agg, int64_t time_ms, double price, long long size);
+void closeBar(BarFrame& f);
+void flushTicks(TickAggregator& agg);
+std::vector<Candle> columnsToCandles(const CandleColumns& c);
+int aggregateCommand(int argc, char* argv[]);
+int64_t parseInterval(const std::string& interval);
+void resampleAppend(std::vector<ResampledSeries>& frames, const std::vector<Candle>& candles);
+std::vector<int8_t> htfTrend(const ResampledSeries& frame, int sma_period);
+void logTrade(const std::string& datetime, const std::string& ticker, const std::string& signal, double entry, double sl, double tp, double lots);
 double computeSMA(const std::vector<double>& prices, size_t end_index, int period);
 double computeRSI(const std::vector<double>& closes, size_t end_index, int period);
 int computeOBVDirection(const std::vector<Candle>& candles, int period);
 double simulateBacktest(const std::vector<Candle>& candles, const StrategyParams& params);
-StrategyParams findBestParameters_Random(const std::vector<Candle>& historical_candles, int num_iterations);
-void process_ticker(const PairConfig& cfg);
+int strategySignal(const SeriesCache& cache, const StrategyParams& params, size_t i);
+LiveRules compileLiveRules(const RuleSet& rules, const StrategyParams& params, bool has_volume);
+std::string liveSignal(const SeriesCache& cache, const StrategyParams& params, const LiveRules& programs, size_t i);
+size_t warmupBars(const StrategyParams& params);
+size_t maxWarmupBars(const std::vector<ParamRange>& space, StrategyKind kind, const RuleSet& rules);
+std::string describeParams(const StrategyParams& params);
+BacktestMetrics simulateBacktestRange(const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end, std::vector<double>* equity = nullptr, std::vector<double>* trades = nullptr, const RuleSet* rules = nullptr);
+template <bool UseVolume>
+BacktestMetrics backtestKernel(const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end, std::vector<double>* equity, std::vector<double>* trades);
+double objectiveValue(const BacktestMetrics& m, const std::string& objective);
+double sharpeRatio(const BacktestMetrics& m);
+double sortinoRatio(const BacktestMetrics& m);
+SeriesCache buildSeriesCache(const std::vector<Candle>& candles);
+void appendSeriesCache(SeriesCache& cache, const std::vector<Candle>& candles);
+void trimSeriesCache(SeriesCache& cache, size_t keep);
+void popSeriesCache(SeriesCache& cache);
+BacktestMetrics streamBacktest(const std::string& path, const StrategyParams& params, const RuleSet& rules, const StreamSettings& settings, std::vector<double>* trades, StreamReport* report);
+void sizeSeries(SeriesCache& cache, double risk_cash, const InstrumentSpec& spec);
+double roundLots(double lots, double lot_step);
+WalkForwardResult runWalkForward(const SeriesCache& cache, size_t end, const RunOptions& opts);
+MonteCarloSummary runMonteCarlo(const std::vector<double>& trades, int resamples, uint64_t seed);
+uint64_t counterRandom(uint64_t seed, uint64_t stream, uint64_t counter);
+StrategyParams findBestParameters_Random(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective);
+StrategyParams findBestParameters_TPE(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective);
+StrategyParams findBestParameters_Evolution(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective, std::vector<GenerationStats>* stats = nullptr);
+StrategyParams findBestParameters_Halving(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective, const HalvingSchedule& schedule);
+StrategyParams findBestParameters(const SeriesCache& cache, size_t begin, size_t end, const RunOptions& opts, std::vector<GenerationStats>* stats = nullptr, ParetoFront* pareto = nullptr);
+bool paretoInsert(ParetoFront& front, const ParetoPoint& p);
+ParetoPoint selectFromPareto(const ParetoFront& front, const std::string& policy);
+void recordTrial(const Objective& objective, StrategyParams& params, const BacktestMetrics& m);
+std::vector<ParamRange> strategyParamSpace(StrategyKind kind);
+bool parseStrategyKind(const std::string& name, StrategyKind& kind);
+StrategyParams decodeParams(const std::vector<ParamRange>& space, const std::vector<double>& unit, StrategyKind kind);
+void repairUnit(const std::vector<ParamRange>& space, std::vector<double>& unit);
+void evaluateBatch(const SeriesCache& cache, size_t begin, size_t end, const Objective& objective, std::vector<StrategyParams>& batch);
+void parallelFor(size_t count, const std::function<void(size_t)>& body);
+WorkerPool* startWorkerPool(size_t n_threads);
+void disableNestedParallelism();
+bool parseOptions(int argc, char* argv[], RunOptions& opts);
+PortfolioSummary runPortfolio(const std::vector<TickerRun>& runs, const RunOptions& opts);
+void mergeTimeline(const std::vector<const std::vector<int64_t>*>& columns, bool include_last, const std::function<void(const std::vector<size_t>&, const std::vector<char>&)>& step, const std::vector<size_t>& start = {}, int64_t until = INT64_MAX);
+int64_t timelineTailStart(const std::vector<const std::vector<int64_t>*>& columns, size_t steps);
+int64_t pushAlignedReturns(RollingCorrelation& rc, const std::vector<TickerRun>& runs, const std::vector<size_t>& members, int64_t after, int64_t until);
+RollingCorrelation makeRollingCorrelation(size_t tickers, size_t window);
+void correlationPush(RollingCorrelation& rc, const double* returns);
+double correlationOf(const RollingCorrelation& rc, size_t a, size_t b);
+void filterCorrelatedSignals(std::vector<TickerRun>& runs, const std::vector<PairConfig>& cfgs, const RunOptions& opts);
+void process_ticker(const PairConfig& cfg, const RunOptions& opts, TickerRun* run = nullptr);
 
 
 
@@ -34,10 +291,16 @@ void process_ticker(const PairConfig& cfg);
 
 
 // --- Core Task for a Thread ---
-void process_ticker(const PairConfig& cfg) {
+void process_ticker(const PairConfig& cfg, const RunOptions& opts, TickerRun* run) {
     std::stringstream output_stream;
     output_stream << "\n--- Processing " << cfg.ticker << " ---" << std::endl;
-    auto candles = readData(cfg.ticker + ".csv");
+    SeriesStats stats;
+    stats.step = parseInterval(cfg.interval);
+    // Streaming keeps only the most recent rows for optimisation and the live signal; the full history is
+    // backtested block by block further down.
+    auto candles = opts.stream_rows > 0 ? streamTail(cfg.ticker + ".csv", opts.stream_tail, opts.stream_rows, &stats)
+                 : !opts.shm.empty() ? readFeed(opts.shm, cfg.ticker, &stats, run ? &run->feed_cursor : nullptr)
+                                     : readData(tickerDataFile(cfg.ticker), &stats);
 
     if (candles.size() < 1) {
         output_stream << "Not enough data for " << cfg.ticker << ". Skipping." << std::endl;
@@ -45,74 +308,245 @@ void process_ticker(const PairConfig& cfg) {
         return;
     }
 
-    std::vector<Candle> optimization_candles(candles.begin(), candles.end() - 1);
-    StrategyParams optimal_params = findBestParameters_Random(optimization_candles, 100);
+    output_stream << "Data " << cfg.ticker << ": " << candles.size() << "/" << stats.rows << (opts.stream_rows > 0 ? " rows (streamed, last kept)" : !opts.shm.empty() ? " rows (shared memory)" : " rows");
+    if (stats.first_time >= 0) output_stream << " " << candles.front().datetime << " .. " << candles.back().datetime;
+    output_stream << ", price " << stats.min_price << " .. " << stats.max_price << ", " << stats.gaps << " gaps"
+                  << (stats.has_volume ? "" : ", no volume");
+    for (const auto& r : stats.rejected) output_stream << ", " << r.second << " rejected (" << r.first << ")";
+    if (stats.out_of_order) output_stream << ", " << stats.out_of_order << " out of order" << (stats.sorted ? " (sorted)" : " (left as is)");
+    if (stats.duplicates) output_stream << ", " << stats.duplicates << " duplicate times (kept the last)";
+    if (stats.untimestamped) output_stream << ", " << stats.untimestamped << " without a parseable time";
+    output_stream << "\n";
 
-    output_stream << "Optimal Params for " << cfg.ticker << ": SMA(" << optimal_params.sma_short << "/" << optimal_params.sma_long
-    << "), RSI(" << optimal_params.rsi_period << ")\n";
+    // Built once and shared by every trial, fold and rung; optimisation uses all candles except the last.
+    SeriesCache cache = buildSeriesCache(candles);
+    double risk_cash = opts.account * opts.risk_percent / 100.0;
+    if (risk_cash > 0 && opts.instrument.pip_value > 0) {
+        sizeSeries(cache, risk_cash, opts.instrument);
+        output_stream << "Sizing " << cfg.ticker << ": risking " << risk_cash << " (" << opts.risk_percent << "% of " << opts.account
+                      << ") per trade, pip value " << opts.instrument.pip_value << ", lot step " << opts.instrument.lot_step << "\n";
+    } else if (risk_cash > 0) {
+        output_stream << "No pip value for " << cfg.ticker << " in analyze_conf.txt, backtesting it unsized.\n";
+    }
+    if (opts.confirm != "off") {
+        // Resample the base bars (cfg.interval) to every higher timeframe in one pass and gate entries on
+        // the confirming one's trend: last closed bar above/below its SMA.
+        std::vector<ResampledSeries> frames;
+        for (const char* interval : {"15m", "1h", "4h"}) {
+            ResampledSeries frame;
+            frame.interval = interval;
+            frame.period = parseInterval(interval);
+            frames.push_back(frame);
+        }
+        int64_t base_period = parseInterval(cfg.interval);
+        bool timestamped = stats.untimestamped == 0;
+        if (timestamped) resampleAppend(frames, candles);
+        auto htf = std::find_if(frames.begin(), frames.end(), [&](const ResampledSeries& f) { return f.interval == opts.confirm; });
+        if (!timestamped || base_period <= 0 || htf->period <= base_period || htf->period % base_period != 0) {
+            output_stream << "Cannot confirm " << cfg.ticker << " (" << cfg.interval << ") on " << opts.confirm << ", trading without it.\n";
+        } else {
+            cache.htf_trend = htfTrend(*htf, opts.confirm_sma);
+            output_stream << "Timeframes " << cfg.ticker << " (" << cfg.interval << " x" << candles.size() << "):";
+            for (const auto& f : frames) output_stream << " " << f.interval << " x" << f.start.size();
+            output_stream << "; entries need the " << opts.confirm << " close on the right side of its SMA" << opts.confirm_sma << "\n";
+        }
+    }
+    std::vector<GenerationStats> generations;
+    ParetoFront front;
+    StrategyParams optimal_params = findBestParameters(cache, 0, candles.size() - 1, opts, &generations, opts.pareto != "off" ? &front : nullptr);
+    if (opts.pareto != "off" && !front.points.empty()) {
+        std::ofstream pareto_file("pareto_" + cfg.ticker + ".csv");
+        pareto_file << "SmaShort,SmaLong,RsiPeriod,SlAtr,TpAtr,ObvPeriod,MinAtrPercent,RsiThreshold,ChannelPeriod,BandK,Profit,MaxDrawdown,Trades\n";
+        for (const auto& q : front.points) {
+            const StrategyParams& qp = q.params;
+            pareto_file << qp.sma_short << "," << qp.sma_long << "," << qp.rsi_period << "," << qp.sl_atr << "," << qp.tp_atr << "," << qp.obv_period << ","
+                        << qp.min_atr_percent << "," << qp.rsi_threshold << "," << qp.channel_period << "," << qp.band_k << "," << q.profit << "," << q.max_drawdown << "," << q.trades << "\n";
+        }
+        optimal_params = selectFromPareto(front, opts.pareto).params;
+        output_stream << "Pareto front for " << cfg.ticker << ": " << front.points.size() << " points, picked by '" << opts.pareto << "'\n";
+    }
+
+    for (const auto& g : generations)
+        output_stream << "  gen " << g.generation << "/" << generations.size() << ": best=" << g.best << " mean=" << g.mean << "\n";
+    output_stream << "Optimal Params for " << cfg.ticker << " [" << opts.optimizer << " x" << opts.iterations << "]: " << describeParams(optimal_params) << "\n";
 
-    std::vector<double> closes;
-    for (const auto& c : candles) closes.push_back(c.close);
+    if (opts.walk_forward) {
+        WalkForwardResult wf = runWalkForward(cache, candles.size() - 1, opts);
+        double is_total = 0, oos_total = 0;
+        for (const auto& f : wf.folds) {
+            output_stream << "  fold " << candles[f.test_begin].datetime << " -> " << candles[f.test_end - 1].datetime
+                          << ": " << describeParams(f.params)
+                          << " IS=" << f.in_sample << " OOS=" << f.out_of_sample << "\n";
+            is_total += f.in_sample;
+            oos_total += f.out_of_sample;
+        }
+        output_stream << "Walk-forward " << cfg.ticker << ": " << wf.folds.size() << " folds, stitched OOS=" << (wf.equity.empty() ? 0.0 : wf.equity.back())
+                      << " (IS total " << is_total << ", OOS total " << oos_total << ")\n";
+    }
+
+    std::vector<double> trades;
+    BacktestMetrics metrics;
+    if (opts.stream_rows > 0) {
+        StreamSettings settings;
+        settings.block_rows = opts.stream_rows;
+        settings.has_volume = stats.has_volume;
+        if (!cache.risk_lots.empty()) { settings.risk_cash = risk_cash; settings.spec = opts.instrument; }
+        StreamReport report;
+        metrics = streamBacktest(cfg.ticker + ".csv", optimal_params, opts.rules, settings, &trades, &report);
+        output_stream << "Streamed " << cfg.ticker << ": " << report.rows << " bars in blocks of " << opts.stream_rows
+                      << ", at most " << report.peak_bars << " in memory at once\n";
+    } else {
+        metrics = simulateBacktestRange(cache, optimal_params, 0, candles.size() - 1, nullptr, &trades, &opts.rules);
+    }
+    output_stream << "Backtest " << cfg.ticker << " [" << opts.objective << "=" << optimal_params.performance << "]: profit=" << metrics.profit
+                  << " trades=" << metrics.trades << " win%=" << (metrics.trades ? 100.0 * metrics.wins / metrics.trades : 0.0)
+                  << " PF=" << (metrics.gross_loss > 0 ? metrics.gross_profit / metrics.gross_loss : 0.0)
+                  << " Sharpe=" << sharpeRatio(metrics) << " Sortino=" << sortinoRatio(metrics) << " MaxDD=" << metrics.max_drawdown
+                  << " exposure%=" << (metrics.bars ? 100.0 * metrics.exposure_bars / metrics.bars : 0.0) << "\n";
+
+    if (opts.monte_carlo > 0) {
+        MonteCarloSummary mc = runMonteCarlo(trades, opts.monte_carlo, opts.mc_seed ^ std::hash<std::string>()(cfg.ticker));
+        output_stream << "Monte Carlo " << cfg.ticker << " (" << mc.resamples << " x " << mc.trades << " trades): PnL p5/p50/p95="
+                      << mc.pnl_p5 << "/" << mc.pnl_p50 << "/" << mc.pnl_p95 << " MaxDD p50/p95/p99="
+                      << mc.dd_p50 << "/" << mc.dd_p95 << "/" << mc.dd_p99 << "\n";
+    }
 
     double current_atr = candles.back().atr;
     double entry = candles.back().close;
-    const float MINIMUM_ATR_PERCENT = 0.10;
+    const float MINIMUM_ATR_PERCENT = optimal_params.min_atr_percent;
     const float high_volatility = 0.30;
     const float extreme_volatility = 0.50;
-    float current_atr_percent = (int)((current_atr / entry) * 100*1000);
-    current_atr_percent = current_atr_percent/1000;
+    float current_atr_percent = cache.atr_percent.back();
     bool is_volatile_enough =  current_atr_percent > MINIMUM_ATR_PERCENT;
 
-    double sma_short = computeSMA(closes, closes.size() - 1, optimal_params.sma_short);
-    double sma_long = computeSMA(closes, closes.size() - 1, optimal_params.sma_long);
-    double rsi = computeRSI(closes, closes.size() - 1, optimal_params.rsi_period);
+    bool use_volume = cache.has_volume;
+    int obv_direction = use_volume ? computeOBVDirection(candles, optimal_params.obv_period) : 0;
 
-    bool use_volume = hasVolumeData(candles);
-    int obv_direction = use_volume ? computeOBVDirection(candles, 14) : 0;
+    size_t last = candles.size() - 1;
+    std::string signal = liveSignal(cache, optimal_params, compileLiveRules(opts.rules, optimal_params, cache.has_volume), last);
 
-    std::string signal = "HOLD";
-    if (use_volume) {
-        if (sma_short > sma_long && rsi > 50 && obv_direction == 1) signal = "BUY";
-        else if (sma_short < sma_long && rsi < 50 && obv_direction == -1) signal = "SELL";
-    } else {
-        if (sma_short > sma_long && rsi > 50) signal = "BUY";
-        else if (sma_short < sma_long && rsi < 50) signal = "SELL";
-    }
+    bool with_trend = cache.htf_trend.empty() || (signal == "BUY" ? cache.htf_trend[last] > 0 : cache.htf_trend[last] < 0);
 
     output_stream << "FINAL SIGNAL: " << candles.back().datetime << " | " << cfg.ticker << " | ";
 
-    if (signal != "HOLD" && is_volatile_enough) {
-        double sl = (signal == "BUY") ? entry - 1.5 * current_atr : entry + 1.5 * current_atr;
-        double tp = (signal == "BUY") ? entry + 2.0 * current_atr : entry - 2.0 * current_atr;
+    if (signal != "HOLD" && is_volatile_enough && with_trend) {
+        double sl = (signal == "BUY") ? entry - optimal_params.sl_atr * current_atr : entry + optimal_params.sl_atr * current_atr;
+        double tp = (signal == "BUY") ? entry + optimal_params.tp_atr * current_atr : entry - optimal_params.tp_atr * current_atr;
         output_stream << signal << " | Entry=" << entry << " SL=" << sl << " TP=" << tp;
-        logTrade(candles.back().datetime, cfg.ticker, signal, entry, sl, tp);
+        double lots = 0;
+        if (!cache.risk_lots.empty()) {
+            lots = roundLots(risk_cash / (std::fabs(entry - sl) * cache.pip_value), cache.lot_step);
+            output_stream << " Lots=" << lots;
+        }
+        if (run) {
+            run->signal = signal;
+            run->datetime = candles.back().datetime;
+            run->entry = entry;
+            run->sl = sl;
+            run->tp = tp;
+            run->lots = lots;
+        } else {
+            logTrade(candles.back().datetime, cfg.ticker, signal, entry, sl, tp, lots);
+        }
     } else {
-        std::string reason = (signal != "HOLD" && !is_volatile_enough) ? " (Ignored: Low Volatility)" : "";
+        std::string reason = (signal != "HOLD" && !is_volatile_enough) ? " (Ignored: Low Volatility)"
+                           : (signal != "HOLD" && !with_trend) ? " (Ignored: Against " + opts.confirm + " Trend)" : "";
         output_stream << "HOLD" << reason;
     }
 
     if (use_volume) output_stream << " | OBV Dir=" << obv_direction;
+    if (!cache.htf_trend.empty()) output_stream << " | " << opts.confirm << " Trend=" << (int)cache.htf_trend[last];
     output_stream << "| ATR% = " << current_atr_percent;
     if(current_atr_percent > high_volatility && current_atr_percent < extreme_volatility) output_stream << "WARNING! HIGH VOLATILITY (> 0.30)";
     if(current_atr_percent > extreme_volatility) output_stream << "WARNING EXTREMELY HIGH VOLATILITY (> 0.50)";
     output_stream << std::endl;
 
     std::cout << output_stream.str();
+    if (run) {
+        run->ticker = cfg.ticker;
+        run->params = optimal_params;
+        run->cache = std::move(cache);
+        run->ok = true;
+    }
 }
 
 // --- Main Program ---
+#ifndef SIGNAL_NO_MAIN
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <config_file>" << std::endl;
+    if (argc >= 2 && std::string(argv[1]) == "compress") return compressCommand(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "replay") return replayCommand(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "aggregate") return aggregateCommand(argc, argv);
+    RunOptions opts;
+    if (argc < 2 || !parseOptions(argc, argv, opts)) {
+        std::cerr << "Usage: " << argv[0] << " compress <in.csv> [out.scol]" << std::endl;
+        std::cerr << "       " << argv[0] << " aggregate <ticks.csv> [--intervals=5m,15m,1h,4h] [--alias]" << std::endl;
+        std::cerr << "       " << argv[0] << " replay <config_file> [--shm=NAME] [--capacity=N] [--history=N] [--speed=X|max]" << std::endl;
+        std::cerr << "       " << argv[0] << " <config_file> [--optimizer=random|tpe|de|halving] [--objective=profit|sharpe|sortino|calmar] [--iterations=N] [--halving-min-bars=N] [--halving-eta=X] [--walk-forward] [--wf-train=N] [--wf-test=N] [--montecarlo=N] [--mc-seed=N] [--pareto=off|knee|profit|drawdown|trades] [--strategy=sma_rsi|breakout|meanrev] [--confirm=off|15m|1h|4h] [--confirm-sma=N] [--jobs=N] [--portfolio[=EQUITY]] [--leverage=X] [--corr-filter[=RHO]] [--corr-window=N] [--risk=PERCENT] [--account=EQUITY] [--stream[=ROWS]] [--stream-tail=N] [--shm[=NAME]] [--live]" << std::endl;
         return 1;
     }
 
-    auto cfgs = readConfig(argv[1]);
-    std::vector<std::thread> workers;
+    opts.space = strategyParamSpace(opts.strategy);
+    if (!readParamSpace(argv[1], opts.space) || !readRuleSet(argv[1], opts.rules)) return 1;
+    if (opts.rules.custom && opts.strategy != StrategyKind::SmaRsiObv) {
+        std::cerr << "rule lines only apply to --strategy=sma_rsi" << std::endl;
+        return 1;
+    }
+    std::vector<PairConfig> cfgs;
+    if (!readConfig(argv[1], cfgs)) return 1;
+    if (!opts.shm.empty()) {
+        FeedSegment seg;
+        if (!openFeed(seg, opts.shm)) return 1;
+        closeFeed(seg);
+    }
+    std::vector<RunOptions> ticker_opts(cfgs.size());
+    for (size_t k = 0; k < cfgs.size(); ++k)
+        if (!tickerOptions(opts, cfgs[k], ticker_opts[k])) return 1;
+    if (opts.risk_percent > 0) {
+        std::map<std::string, InstrumentSpec> specs = readInstrumentSpecs("analyze_conf.txt");
+        for (size_t k = 0; k < cfgs.size(); ++k) {
+            auto it = specs.find(cfgs[k].ticker);
+            if (it != specs.end()) ticker_opts[k].instrument = it->second;
+        }
+    }
 
-    for (const auto& cfg : cfgs) {
-        // Corrected typo from ProcessTicker to process_ticker
-        workers.emplace_back(process_ticker, cfg);
+    // Cost model: rows x trials, scaled by each ticker's measured seconds per row-trial from earlier runs
+    // (the mean of the known rates for tickers without history).
+    std::map<std::string, double> per_unit = readTimings("timings.csv");
+    double default_rate = 1.0;
+    if (!per_unit.empty()) {
+        default_rate = 0;
+        for (const auto& t : per_unit) default_rate += t.second / per_unit.size();
+    }
+    std::vector<TickerJob> jobs;
+    for (size_t k = 0; k < cfgs.size(); ++k) {
+        size_t rows = !opts.shm.empty() ? feedRows(opts.shm, cfgs[k].ticker)
+                    : countRows(opts.stream_rows > 0 ? cfgs[k].ticker + ".csv" : tickerDataFile(cfgs[k].ticker));
+        auto known = per_unit.find(cfgs[k].ticker);
+        double rate = known != per_unit.end() ? known->second : default_rate;
+        jobs.push_back({k, rows, ticker_opts[k].iterations, rate * rows * ticker_opts[k].iterations, 0.0});
+    }
+
+    // Tickers go to a pool of --jobs workers (default: one per core): highest priority first, and within a
+    // priority longest-processing-time first, so no long ticker starts last and defines the wall clock.
+    std::stable_sort(jobs.begin(), jobs.end(), [&](const TickerJob& a, const TickerJob& b) {
+        if (cfgs[a.index].priority != cfgs[b.index].priority) return cfgs[a.index].priority > cfgs[b.index].priority;
+        return a.estimate > b.estimate;
+    });
+    size_t n_jobs = opts.jobs > 0 ? opts.jobs : std::max(1u, std::thread::hardware_concurrency());
+    std::atomic<size_t> next_ticker{0};
+    std::vector<TickerRun> runs(cfgs.size());
+    std::vector<std::thread> workers;
+    auto run_start = std::chrono::steady_clock::now();
+    for (size_t w = 0; w < std::min(n_jobs, cfgs.size()); ++w) {
+        workers.emplace_back([&]() {
+            // With several tickers in flight the cores are already busy, so each ticker runs serially inside.
+            if (std::min(n_jobs, cfgs.size()) > 1) disableNestedParallelism();
+            for (size_t k; (k = next_ticker++) < jobs.size();) {
+                auto start = std::chrono::steady_clock::now();
+                process_ticker(cfgs[jobs[k].index], ticker_opts[jobs[k].index], &runs[jobs[k].index]);
+                jobs[k].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        });
     }
 
     std::cout << "Launched " << workers.size() << " worker threads. Waiting for completion..." << std::endl;
@@ -121,38 +555,244 @@ int main(int argc, char* argv[]) {
             worker.join();
         }
     }
+    double makespan = std::chrono::duration<double>(std::chrono::steady_clock::now() - run_start).count();
+
+    // No schedule on these workers can beat the longest ticker or the total work spread evenly.
+    double total = 0, longest = 0;
+    for (const auto& job : jobs) {
+        total += job.seconds;
+        longest = std::max(longest, job.seconds);
+        if (job.rows > 0) per_unit[cfgs[job.index].ticker] = job.seconds / ((double)job.rows * job.iterations);
+    }
+    double lower_bound = std::max(longest, total / std::min(n_jobs, std::max<size_t>(1, jobs.size())));
+    writeTimings("timings.csv", per_unit);
+    std::cout << "\nSchedule: " << jobs.size() << " tickers on " << std::min(n_jobs, jobs.size()) << " workers, makespan " << makespan
+              << "s vs lower bound " << lower_bound << "s (" << (lower_bound > 0 ? makespan / lower_bound : 1.0) << "x)" << std::endl;
+    // Signals are logged only now, after the cross-ticker filter has seen all of them.
+    if (opts.corr_filter > 0) filterCorrelatedSignals(runs, cfgs, opts);
+    for (const auto& r : runs)
+        if (r.ok && r.signal != "HOLD") logTrade(r.datetime, r.ticker, r.signal, r.entry, r.sl, r.tp, r.lots);
+
+    if (opts.portfolio > 0) {
+        PortfolioSummary pf = runPortfolio(runs, opts);
+        std::cout << "\nPortfolio (" << std::count_if(runs.begin(), runs.end(), [](const TickerRun& r) { return r.ok; }) << " tickers, "
+                  << pf.steps << " aligned bars, " << opts.leverage << "x): equity " << pf.start_equity << " -> " << pf.end_equity
+                  << " (" << 100.0 * (pf.end_equity / pf.start_equity - 1) << "%) maxDD=" << 100.0 * pf.max_drawdown << "% trades=" << pf.trades
+                  << " peak positions=" << pf.peak_positions << " peak margin=" << 100.0 * pf.peak_margin << "% refused=" << pf.refused << std::endl;
+    }
     std::cout << "\n--- All tasks complete. ---" << std::endl;
+    if (opts.live) followFeed(runs, ticker_opts, opts);
     return 0;
 }
+#endif
 
 // --- Full Function Implementations ---
-std::vector<PairConfig> readConfig(const std::string& file) {
-    std::vector<PairConfig> cfgs;
+// Ticker lines: TICKER INTERVAL [ITERATIONS] [key=value ...], keys: iterations, optimizer, objective,
+// priority, range.<param>=lo:hi. Anything after a '#' is a comment.
+bool readConfig(const std::string& file, std::vector<PairConfig>& cfgs) {
     std::ifstream f(file);
     std::string line;
     while (getline(f, line)) {
-        if (line.empty() || line[0] == '#') continue;
+        line = line.substr(0, line.find('#'));
+        if (line.rfind("range ", 0) == 0 || line.rfind("rule ", 0) == 0) continue;
         std::stringstream ss(line);
         PairConfig p;
-        ss >> p.ticker >> p.interval; // Reads only ticker and interval
+        if (!(ss >> p.ticker)) continue;
+        ss >> p.interval;
+        std::string token;
+        try {
+            while (ss >> token) {
+                size_t eq = token.find('=');
+                std::string key = (eq == std::string::npos) ? "iterations" : token.substr(0, eq);
+                std::string value = (eq == std::string::npos) ? token : token.substr(eq + 1);
+                size_t colon = value.find(':');
+                if (key == "iterations") p.iterations = std::stoi(value);
+                else if (key == "optimizer") p.optimizer = value;
+                else if (key == "objective") p.objective = value;
+                else if (key == "priority") p.priority = std::stoi(value);
+                else if (key.rfind("range.", 0) == 0 && colon != std::string::npos)
+                    p.ranges.push_back({key.substr(6), std::stod(value.substr(0, colon)), std::stod(value.substr(colon + 1)), false});
+                else throw std::invalid_argument(token);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Bad setting '" << token << "' for " << p.ticker << " in " << file << std::endl;
+            return false;
+        }
         cfgs.push_back(p);
     }
-    return cfgs;
+    return true;
+}
+// The global options with this ticker's overrides applied.
+bool tickerOptions(const RunOptions& base, const PairConfig& cfg, RunOptions& out) {
+    out = base;
+    if (cfg.iterations != 0) out.iterations = cfg.iterations;
+    if (!cfg.optimizer.empty()) out.optimizer = cfg.optimizer;
+    if (!cfg.objective.empty()) out.objective = cfg.objective;
+    bool ok = out.iterations > 0 && validOptimizer(out.optimizer) && validObjective(out.objective);
+    for (const auto& r : cfg.ranges) {
+        auto it = std::find_if(out.space.begin(), out.space.end(), [&](const ParamRange& d) { return d.name == r.name; });
+        if (it == out.space.end() || r.lo > r.hi) { ok = false; break; }
+        it->lo = r.lo;
+        it->hi = r.hi;
+    }
+    if (!ok) {
+        std::cerr << "Bad settings for " << cfg.ticker << " (iterations, optimizer, objective or range)" << std::endl;
+        return false;
+    }
+    size_t warmup = maxWarmupBars(out.space, out.strategy, out.rules);
+    if (out.walk_forward && out.wf_train < warmup) {
+        std::cerr << "--wf-train=" << out.wf_train << " is shorter than the " << warmup << " bars " << cfg.ticker << "'s search space can need to warm up" << std::endl;
+        return false;
+    }
+    return true;
 }
-StrategyParams findBestParameters_Random(const std::vector<Candle>& historical_candles, int num_iterations) {
+// Data rows (lines after the header, or a .scol header's count), counted without parsing so jobs can be
+// costed up front.
+size_t countRows(const std::string& file) {
+    std::ifstream f(file, std::ios::binary);
+    if (isColumnarFile(file)) {
+        char header[16];
+        uint64_t rows = 0;
+        if (f.read(header, sizeof(header)) && memcmp(header, "SCOL", 4) == 0) memcpy(&rows, header + 8, 8);
+        return rows;
+    }
+    std::vector<char> buffer(1 << 16);
+    size_t lines = 0;
+    while (f.read(buffer.data(), buffer.size()) || f.gcount() > 0) {
+        lines += std::count(buffer.begin(), buffer.begin() + f.gcount(), '\n');
+        if (!f) break;
+    }
+    return lines > 0 ? lines - 1 : 0;
+}
+// Seconds per row-trial by ticker, as measured on earlier runs.
+std::map<std::string, double> readTimings(const std::string& file) {
+    std::map<std::string, double> per_unit;
+    std::ifstream f(file);
+    std::string line;
+    getline(f, line); // Skip header
+    while (getline(f, line)) {
+        std::stringstream ss(line);
+        std::string ticker, rate;
+        getline(ss, ticker, ',');
+        getline(ss, rate, ',');
+        try { per_unit[ticker] = std::stod(rate); } catch (const std::exception& e) {}
+    }
+    return per_unit;
+}
+void writeTimings(const std::string& file, const std::map<std::string, double>& per_unit) {
+    std::ofstream f(file);
+    f << "Ticker,SecondsPerRowTrial\n";
+    for (const auto& t : per_unit) f << t.first << "," << std::setprecision(6) << t.second << "\n";
+}
+// analyze_conf.txt: "TICKER SPREAD LOT_SIZE PIP_VALUE" per line, '#' lines are comments. LOT_SIZE is the
+// broker's lot step; a line without PIP_VALUE leaves it 0, i.e. the ticker cannot be sized.
+std::map<std::string, InstrumentSpec> readInstrumentSpecs(const std::string& file) {
+    std::map<std::string, InstrumentSpec> specs;
+    std::ifstream f(file);
+    if (!f) std::cerr << "Warning: " << file << " not found, trading unsized." << std::endl;
+    std::string line;
+    while (getline(f, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream ss(line);
+        std::string ticker;
+        InstrumentSpec spec;
+        if (ss >> ticker >> spec.spread >> spec.lot_step) {
+            if (!(ss >> spec.pip_value)) spec.pip_value = 0;
+            specs[ticker] = spec;
+        }
+    }
+    return specs;
+}
+bool validOptimizer(const std::string& name) { return name == "random" || name == "tpe" || name == "de" || name == "halving"; }
+bool validObjective(const std::string& name) { return name == "profit" || name == "sharpe" || name == "sortino" || name == "calmar"; }
+// "range <name> <lo> <hi>" lines in the config override the default search range of one parameter;
+// lo == hi pins it.
+bool readParamSpace(const std::string& file, std::vector<ParamRange>& space) {
+    std::ifstream f(file);
+    std::string line;
+    while (getline(f, line)) {
+        if (line.rfind("range ", 0) != 0) continue;
+        std::stringstream ss(line);
+        std::string keyword, name;
+        double lo, hi;
+        if (!(ss >> keyword >> name >> lo >> hi) || lo > hi) {
+            std::cerr << "Bad range line in " << file << ": " << line << std::endl;
+            return false;
+        }
+        auto it = std::find_if(space.begin(), space.end(), [&](const ParamRange& r) { return r.name == name; });
+        if (it == space.end()) {
+            std::cerr << "Unknown parameter in " << file << ": " << name << std::endl;
+            return false;
+        }
+        it->lo = lo;
+        it->hi = hi;
+    }
+    return true;
+}
+bool parseOptions(int argc, char* argv[], RunOptions& opts) {
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+        try {
+            if (key == "--optimizer") opts.optimizer = value;
+            else if (key == "--objective") opts.objective = value;
+            else if (key == "--iterations") opts.iterations = std::stoi(value);
+            else if (key == "--halving-min-bars") opts.halving.min_bars = std::stoul(value);
+            else if (key == "--halving-eta") opts.halving.eta = std::stod(value);
+            else if (key == "--walk-forward") opts.walk_forward = true;
+            else if (key == "--wf-train") opts.wf_train = std::stoul(value);
+            else if (key == "--wf-test") opts.wf_test = std::stoul(value);
+            else if (key == "--montecarlo") opts.monte_carlo = std::stoi(value);
+            else if (key == "--mc-seed") opts.mc_seed = std::stoull(value);
+            else if (key == "--pareto") opts.pareto = value.empty() ? "knee" : value;
+            else if (key == "--strategy") { if (!parseStrategyKind(value, opts.strategy)) return false; }
+            else if (key == "--confirm") opts.confirm = value;
+            else if (key == "--confirm-sma") opts.confirm_sma = std::stoi(value);
+            else if (key == "--jobs") opts.jobs = std::stoi(value);
+            else if (key == "--portfolio") opts.portfolio = value.empty() ? 10000 : std::stod(value);
+            else if (key == "--leverage") opts.leverage = std::stod(value);
+            else if (key == "--corr-filter") opts.corr_filter = value.empty() ? 0.8 : std::stod(value);
+            else if (key == "--corr-window") opts.corr_window = std::stoul(value);
+            else if (key == "--risk") opts.risk_percent = std::stod(value);
+            else if (key == "--account") opts.account = std::stod(value);
+            else if (key == "--stream") opts.stream_rows = value.empty() ? 100000 : std::stoul(value);
+            else if (key == "--stream-tail") opts.stream_tail = std::stoul(value);
+            else if (key == "--shm") opts.shm = value.empty() ? "signal_feed" : value;
+            else if (key == "--live") opts.live = true;
+            else return false;
+        } catch (const std::exception& e) { return false; }
+    }
+    if (!validOptimizer(opts.optimizer) || !validObjective(opts.objective)) return false;
+    if (opts.confirm != "off" && opts.confirm != "15m" && opts.confirm != "1h" && opts.confirm != "4h") return false;
+    if (opts.pareto != "off" && opts.pareto != "knee" && opts.pareto != "profit" && opts.pareto != "drawdown" && opts.pareto != "trades") return false;
+    return opts.iterations > 0 && opts.halving.min_bars > 0 && opts.halving.eta > 1.0 && opts.wf_test > 0
+        && opts.wf_train >= maxWarmupBars(strategyParamSpace(opts.strategy), opts.strategy, RuleSet()) && opts.monte_carlo >= 0 && opts.confirm_sma > 0 && opts.jobs >= 0 && opts.portfolio >= 0 && opts.leverage > 0
+        && opts.corr_filter >= 0 && opts.corr_filter <= 1 && opts.corr_window > 1
+        && opts.risk_percent >= 0 && opts.risk_percent <= 100 && opts.account > 0
+        && opts.stream_tail > 0 && (opts.stream_rows == 0 || opts.confirm == "off") && (opts.stream_rows == 0 || opts.shm.empty())
+        && (!opts.live || (!opts.shm.empty() && opts.confirm == "off"));
+}
+StrategyParams findBestParameters(const SeriesCache& cache, size_t begin, size_t end, const RunOptions& opts, std::vector<GenerationStats>* stats, ParetoFront* pareto) {
+    Objective objective{opts.objective, pareto, &opts.rules, opts.strategy};
+    if (opts.optimizer == "tpe") return findBestParameters_TPE(cache, begin, end, opts.space, opts.iterations, objective);
+    if (opts.optimizer == "de") return findBestParameters_Evolution(cache, begin, end, opts.space, opts.iterations, objective, stats);
+    if (opts.optimizer == "halving") return findBestParameters_Halving(cache, begin, end, opts.space, opts.iterations, objective, opts.halving);
+    return findBestParameters_Random(cache, begin, end, opts.space, opts.iterations, objective);
+}
+StrategyParams findBestParameters_Random(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective) {
     StrategyParams best_params;
+    best_params.strategy = objective.strategy;  // returned as is if no trial is valid (too little history)
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib_short(5, 15);
-    std::uniform_int_distribution<> distrib_long_diff(5, 30);
-    std::uniform_int_distribution<> distrib_rsi(7, 21);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::vector<double> x(space.size());
 
     for (int i = 0; i < num_iterations; ++i) {
-        StrategyParams current_params;
-        current_params.sma_short = distrib_short(gen);
-        current_params.sma_long = current_params.sma_short + distrib_long_diff(gen);
-        current_params.rsi_period = distrib_rsi(gen);
-        current_params.performance = simulateBacktest(historical_candles, current_params);
+        for (auto& v : x) v = unit(gen);
+        StrategyParams current_params = decodeParams(space, x, objective.strategy);
+        recordTrial(objective, current_params, simulateBacktestRange(cache, current_params, begin, end, nullptr, nullptr, objective.rules));
 
         if (current_params.performance > best_params.performance) {
             best_params = current_params;
@@ -160,40 +800,2061 @@ StrategyParams findBestParameters_Random(const std::vector<Candle>& historical_c
     }
     return best_params;
 }
+bool parseStrategyKind(const std::string& name, StrategyKind& kind) {
+    if (name == "sma_rsi") kind = StrategyKind::SmaRsiObv;
+    else if (name == "breakout") kind = StrategyKind::Breakout;
+    else if (name == "meanrev") kind = StrategyKind::MeanReversion;
+    else return false;
+    return true;
+}
+// Dimensions are matched by name, so any strategy's space (with conf.txt overrides) decodes here.
+StrategyParams decodeParams(const std::vector<ParamRange>& space, const std::vector<double>& unit, StrategyKind kind) {
+    StrategyParams p;
+    p.strategy = kind;
+    int sma_long_diff = p.sma_long - p.sma_short;
+    for (size_t d = 0; d < space.size(); ++d) {
+        double u = std::min(1.0, std::max(0.0, unit[d]));
+        double v = space[d].lo + u * (space[d].hi - space[d].lo);
+        if (space[d].integer) v = std::round(v);
+        const std::string& name = space[d].name;
+        if (name == "sma_short") p.sma_short = (int)v;
+        else if (name == "sma_long_diff") sma_long_diff = (int)v;
+        else if (name == "rsi_period") p.rsi_period = (int)v;
+        else if (name == "sl_atr") p.sl_atr = v;
+        else if (name == "tp_atr") p.tp_atr = v;
+        else if (name == "obv_period") p.obv_period = (int)v;
+        else if (name == "min_atr_percent") p.min_atr_percent = v;
+        else if (name == "rsi_threshold") p.rsi_threshold = v;
+        else if (name == "channel_period") p.channel_period = (int)v;
+        else if (name == "band_k") p.band_k = v;
+    }
+    p.sma_long = p.sma_short + sma_long_diff;
+    return p;
+}
+void repairUnit(const std::vector<ParamRange>& space, std::vector<double>& unit) {
+    // Clamp into the box and snap integer dimensions onto the grid decodeParams will round to.
+    for (size_t d = 0; d < space.size(); ++d) {
+        unit[d] = std::min(1.0, std::max(0.0, unit[d]));
+        double width = space[d].hi - space[d].lo;
+        if (space[d].integer && width > 0) unit[d] = std::round(unit[d] * width) / width;
+    }
+}
+// Runs body(0..count-1) on the caller plus one shared pool of cores-1 threads, so batches pay no thread
+// start-up. Nested calls (an optimiser batch inside a parallel walk-forward fold), calls from threads that
+// disabled nesting, and calls made while another thread holds the pool all run inline on the caller.
+thread_local bool inside_worker = false;
+void parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    static WorkerPool* pool = startWorkerPool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    std::unique_lock<std::mutex> caller(pool->caller, std::defer_lock);
+    if (count <= 1 || inside_worker || pool->threads.empty() || !caller.try_lock()) {
+        for (size_t i = 0; i < count; ++i) body(i);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pool->mtx);
+        pool->body = &body;
+        pool->count = count;
+        pool->next = 0;
+        pool->busy = pool->threads.size();
+        pool->generation++;
+    }
+    pool->wake.notify_all();
+    inside_worker = true;
+    for (size_t i = pool->next++; i < count; i = pool->next++) body(i);
+    inside_worker = false;
+    std::unique_lock<std::mutex> lock(pool->mtx);
+    pool->done.wait(lock, [&] { return pool->busy == 0; });
+}
+// The pool lives until exit; its threads sleep between batches.
+WorkerPool* startWorkerPool(size_t n_threads) {
+    WorkerPool* pool = new WorkerPool;
+    for (size_t t = 0; t < n_threads; ++t) {
+        pool->threads.emplace_back([pool]() {
+            inside_worker = true;
+            uint64_t seen = 0;
+            std::unique_lock<std::mutex> lock(pool->mtx);
+            while (true) {
+                pool->wake.wait(lock, [&] { return pool->generation != seen; });
+                seen = pool->generation;
+                const std::function<void(size_t)>& body = *pool->body;
+                size_t count = pool->count;
+                lock.unlock();
+                for (size_t i = pool->next++; i < count; i = pool->next++) body(i);
+                lock.lock();
+                if (--pool->busy == 0) pool->done.notify_one();
+            }
+        });
+        pool->threads.back().detach();
+    }
+    return pool;
+}
+void disableNestedParallelism() {
+    inside_worker = true;
+}
+void evaluateBatch(const SeriesCache& cache, size_t begin, size_t end, const Objective& objective, std::vector<StrategyParams>& batch) {
+    parallelFor(batch.size(), [&](size_t i) { recordTrial(objective, batch[i], simulateBacktestRange(cache, batch[i], begin, end, nullptr, nullptr, objective.rules)); });
+}
+void recordTrial(const Objective& objective, StrategyParams& params, const BacktestMetrics& m) {
+    params.performance = objectiveValue(m, objective.metric);
+    if (objective.pareto && m.valid) paretoInsert(*objective.pareto, {params, m.profit, m.max_drawdown, m.trades});
+}
+// Non-dominated set over (max profit, min drawdown, max trades). Points are kept sorted by profit,
+// descending, so only points with at least the new profit can dominate it and only points with at
+// most its profit can be dominated by it.
+bool paretoInsert(ParetoFront& front, const ParetoPoint& p) {
+    std::lock_guard<std::mutex> lock(front.mtx);
+    auto& pts = front.points;
+    auto by_profit = [](const ParetoPoint& a, const ParetoPoint& b) { return a.profit > b.profit; };
+    auto upper = std::upper_bound(pts.begin(), pts.end(), p, by_profit);
+    for (auto it = pts.begin(); it != upper; ++it)
+        if (it->max_drawdown <= p.max_drawdown && it->trades >= p.trades) return false;
+    auto lower = std::lower_bound(pts.begin(), pts.end(), p, by_profit);
+    auto kept = std::remove_if(lower, pts.end(), [&](const ParetoPoint& q) { return p.max_drawdown <= q.max_drawdown && p.trades >= q.trades; });
+    pts.erase(kept, pts.end());
+    pts.insert(std::lower_bound(pts.begin(), pts.end(), p, by_profit), p);
+    return true;
+}
+// "profit" / "drawdown" / "trades" take the extreme point on that axis; "knee" takes the point closest
+// to the ideal corner after scaling each objective to [0, 1] across the front.
+ParetoPoint selectFromPareto(const ParetoFront& front, const std::string& policy) {
+    const auto& pts = front.points;
+    if (policy == "profit") return pts.front();
+    if (policy == "drawdown") return *std::min_element(pts.begin(), pts.end(), [](const ParetoPoint& a, const ParetoPoint& b) { return a.max_drawdown < b.max_drawdown; });
+    if (policy == "trades") return *std::max_element(pts.begin(), pts.end(), [](const ParetoPoint& a, const ParetoPoint& b) { return a.trades < b.trades; });
+    double p_lo = pts.back().profit, p_hi = pts.front().profit;
+    double d_lo = 1e300, d_hi = -1e300, t_lo = 1e300, t_hi = -1e300;
+    for (const auto& q : pts) {
+        d_lo = std::min(d_lo, q.max_drawdown); d_hi = std::max(d_hi, q.max_drawdown);
+        t_lo = std::min(t_lo, (double)q.trades); t_hi = std::max(t_hi, (double)q.trades);
+    }
+    auto scaled = [](double v, double lo, double hi) { return hi > lo ? (v - lo) / (hi - lo) : 1.0; };
+    size_t best = 0;
+    double best_dist = 1e300;
+    for (size_t i = 0; i < pts.size(); ++i) {
+        double dp = 1.0 - scaled(pts[i].profit, p_lo, p_hi);
+        double dd = scaled(pts[i].max_drawdown, d_lo, d_hi);
+        double dt = 1.0 - scaled(pts[i].trades, t_lo, t_hi);
+        double dist = dp * dp + dd * dd + dt * dt;
+        if (dist < best_dist) { best_dist = dist; best = i; }
+    }
+    return pts[best];
+}
+// Tree-structured Parzen estimator: split the trials seen so far into a good (top 25%) and a bad set,
+// fit a per-dimension Gaussian KDE to each, and propose the candidates maximising l(x)/g(x).
+// Proposals are made a batch at a time so each round is evaluated in parallel.
+StrategyParams findBestParameters_TPE(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective) {
+    const double gamma = 0.25;
+    const int candidates_per_proposal = 24;
+    const size_t dims = space.size();
+    const int batch_size = std::max(1, std::min(num_iterations, (int)std::max(1u, std::thread::hardware_concurrency())));
+    const int n_startup = std::min(num_iterations, std::max(batch_size, num_iterations / 4));
 
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::normal_distribution<> normal(0.0, 1.0);
 
-std::vector<Candle> readData(const std::string& file) {
-    std::vector<Candle> candles;
+    std::vector<std::vector<double>> xs;
+    std::vector<double> ys;
+    std::map<std::vector<double>, bool> seen;
+    StrategyParams best_params;
+    best_params.strategy = objective.strategy;
+    auto key_of = [](const StrategyParams& p) {
+        return std::vector<double>{(double)p.sma_short, (double)p.sma_long, (double)p.rsi_period, p.sl_atr, p.tp_atr, (double)p.obv_period, p.min_atr_percent, p.rsi_threshold,
+                                   (double)p.channel_period, p.band_k};
+    };
+
+    auto run_batch = [&](const std::vector<std::vector<double>>& points) {
+        std::vector<StrategyParams> batch;
+        for (const auto& x : points) batch.push_back(decodeParams(space, x, objective.strategy));
+        evaluateBatch(cache, begin, end, objective, batch);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            xs.push_back(points[i]);
+            ys.push_back(batch[i].performance);
+            if (batch[i].performance > best_params.performance) best_params = batch[i];
+        }
+    };
+
+    // Gaussian KDE on [0,1] with a uniform prior component so unexplored regions keep some mass.
+    auto bandwidth = [&](const std::vector<size_t>& idx, size_t d) {
+        double mean = 0, var = 0;
+        for (size_t i : idx) mean += xs[i][d];
+        mean /= idx.size();
+        for (size_t i : idx) var += (xs[i][d] - mean) * (xs[i][d] - mean);
+        double sd = std::sqrt(var / idx.size());
+        return std::max(0.05, 1.06 * sd * std::pow((double)idx.size(), -0.2));
+    };
+    auto log_density = [&](const std::vector<size_t>& idx, const std::vector<double>& bw, const std::vector<double>& x) {
+        double total = 0;
+        for (size_t d = 0; d < dims; ++d) {
+            double dens = 1.0;
+            for (size_t i : idx) {
+                double z = (x[d] - xs[i][d]) / bw[d];
+                dens += std::exp(-0.5 * z * z) / (bw[d] * 2.5066282746310002);
+            }
+            total += std::log(dens / (idx.size() + 1));
+        }
+        return total;
+    };
+
+    std::vector<std::vector<double>> startup;
+    for (int attempt = 0; (int)startup.size() < n_startup; ++attempt) {
+        std::vector<double> x(dims);
+        for (auto& v : x) v = unit(gen);
+        if (seen.emplace(key_of(decodeParams(space, x, objective.strategy)), true).second || attempt >= 20 * n_startup) startup.push_back(x);
+    }
+    run_batch(startup);
+
+    while ((int)ys.size() < num_iterations) {
+        std::vector<size_t> order(ys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ys[a] > ys[b]; });
+        size_t n_good = std::max<size_t>(1, (size_t)std::ceil(gamma * order.size()));
+        std::vector<size_t> good(order.begin(), order.begin() + n_good);
+        std::vector<size_t> bad(order.begin() + n_good, order.end());
+        if (bad.empty()) bad = good;
+
+        std::vector<double> bw_good(dims), bw_bad(dims);
+        for (size_t d = 0; d < dims; ++d) { bw_good[d] = bandwidth(good, d); bw_bad[d] = bandwidth(bad, d); }
+
+        int want = std::min(batch_size, num_iterations - (int)ys.size());
+        std::vector<std::pair<double, std::vector<double>>> scored;
+        std::uniform_int_distribution<size_t> pick(0, good.size());
+        for (int c = 0; c < want * candidates_per_proposal; ++c) {
+            std::vector<double> x(dims);
+            size_t k = pick(gen);
+            for (size_t d = 0; d < dims; ++d) {
+                if (k == good.size()) { x[d] = unit(gen); continue; }
+                double v = xs[good[k]][d] + bw_good[d] * normal(gen);
+                x[d] = std::min(1.0, std::max(0.0, v));
+            }
+            scored.push_back({log_density(good, bw_good, x) - log_density(bad, bw_bad, x), x});
+        }
+        std::sort(scored.begin(), scored.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        std::vector<std::vector<double>> proposals;
+        for (const auto& s : scored) {
+            if ((int)proposals.size() == want) break;
+            if (seen.emplace(key_of(decodeParams(space, s.second, objective.strategy)), true).second) proposals.push_back(s.second);
+        }
+        // Every candidate already tried (small integer space): fall back to fresh uniform draws.
+        while ((int)proposals.size() < want) {
+            std::vector<double> x(dims);
+            for (auto& v : x) v = unit(gen);
+            proposals.push_back(x);
+        }
+        run_batch(proposals);
+    }
+    return best_params;
+}
+
+// Differential evolution (DE/current-to-best/1/bin). Each generation's trial vectors are evaluated
+// as one parallel batch; a trial replaces its parent only if it does at least as well.
+StrategyParams findBestParameters_Evolution(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective, std::vector<GenerationStats>* stats) {
+    // A current-to-best/1 mutant needs two distinct donors besides its target (and the best member), and
+    // selection needs a population of at least 4 to mean anything; a smaller budget goes to random search.
+    if (num_iterations < 4) return findBestParameters_Random(cache, begin, end, space, num_iterations, objective);
+    const double F = 0.6, CR = 0.9;
+    const size_t dims = space.size();
+    const int pop_size = std::max(4, std::min((int)(10 * dims), num_iterations / 5));
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::uniform_int_distribution<> pick(0, pop_size - 1);
+    std::uniform_int_distribution<size_t> pick_dim(0, dims - 1);
+
+    std::vector<std::vector<double>> pop(pop_size, std::vector<double>(dims));
+    std::vector<StrategyParams> members(pop_size);
+    for (int i = 0; i < pop_size; ++i) {
+        for (auto& v : pop[i]) v = unit(gen);
+        repairUnit(space, pop[i]);
+        members[i] = decodeParams(space, pop[i], objective.strategy);
+    }
+    evaluateBatch(cache, begin, end, objective, members);
+    int used = pop_size;
+
+    auto record = [&](int generation) {
+        double best = -1e18, mean = 0;
+        for (const auto& m : members) { best = std::max(best, m.performance); mean += m.performance; }
+        if (stats) stats->push_back({generation, best, mean / pop_size});
+    };
+    record(0);
+
+    // The last generation may be partial: only the first `batch` members get a trial, so the whole
+    // budget is spent.
+    for (int generation = 1; used < num_iterations; ++generation) {
+        int best_idx = 0;
+        for (int i = 1; i < pop_size; ++i) if (members[i].performance > members[best_idx].performance) best_idx = i;
+
+        const int batch = std::min(pop_size, num_iterations - used);
+        std::vector<std::vector<double>> trials(batch, std::vector<double>(dims));
+        std::vector<StrategyParams> trial_params(batch);
+        for (int i = 0; i < batch; ++i) {
+            int a, b;
+            do { a = pick(gen); } while (a == i);
+            do { b = pick(gen); } while (b == i || b == a);
+            size_t forced = pick_dim(gen);
+            for (size_t d = 0; d < dims; ++d) {
+                double mutant = pop[i][d] + F * (pop[best_idx][d] - pop[i][d]) + F * (pop[a][d] - pop[b][d]);
+                trials[i][d] = (d == forced || unit(gen) < CR) ? mutant : pop[i][d];
+            }
+            repairUnit(space, trials[i]);
+            trial_params[i] = decodeParams(space, trials[i], objective.strategy);
+        }
+        evaluateBatch(cache, begin, end, objective, trial_params);
+        used += batch;
+
+        for (int i = 0; i < batch; ++i) {
+            if (trial_params[i].performance >= members[i].performance) {
+                pop[i] = trials[i];
+                members[i] = trial_params[i];
+            }
+        }
+        record(generation);
+    }
+
+    StrategyParams best_params;
+    best_params.strategy = objective.strategy;
+    for (const auto& m : members) if (m.performance > best_params.performance) best_params = m;
+    return best_params;
+}
+// Successive halving: num_iterations is converted into a budget of bar-evaluations (num_iterations full
+// backtests). Many candidates are scored on the most recent min_bars, the best 1/eta survive to a
+// window eta times longer, and so on until the survivors are scored on the full history. The first
+// window is at least the longest warmup in the space plus HALVING_MIN_TRADED bars, so no rung scores
+// every candidate as invalid and culls at random.
+const size_t HALVING_MIN_TRADED = 100;
+StrategyParams findBestParameters_Halving(const SeriesCache& cache, size_t begin, size_t end, const std::vector<ParamRange>& space, int num_iterations, const Objective& objective, const HalvingSchedule& schedule) {
+    const size_t n_bars = end - begin;
+    if (n_bars == 0) return findBestParameters_Random(cache, begin, end, space, num_iterations, objective);
+    size_t min_window = maxWarmupBars(space, objective.strategy, objective.rules ? *objective.rules : RuleSet()) + HALVING_MIN_TRADED;
+    std::vector<size_t> windows;
+    for (double w = (double)std::max(schedule.min_bars, min_window); ; w *= schedule.eta) {
+        windows.push_back(std::min(n_bars, (size_t)w));
+        if (windows.back() == n_bars) break;
+    }
+
+    // Survivors shrink by eta per rung, so rung k costs roughly n0 * windows[k] / eta^k bars.
+    double bars_per_candidate = 0, shrink = 1.0;
+    for (size_t w : windows) { bars_per_candidate += w / shrink; shrink *= schedule.eta; }
+    double budget = (double)num_iterations * n_bars;
+    size_t n_candidates = std::max<size_t>(1, (size_t)(budget / bars_per_candidate));
+
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+
+    std::vector<StrategyParams> survivors(n_candidates);
+    for (auto& p : survivors) {
+        std::vector<double> x(space.size());
+        for (auto& v : x) v = unit(gen);
+        p = decodeParams(space, x, objective.strategy);
+    }
+
+    for (size_t rung = 0; rung < windows.size(); ++rung) {
+        // Only full-history scores are comparable with other trials, so earlier rungs stay off the front.
+        Objective rung_objective{objective.metric, rung + 1 == windows.size() ? objective.pareto : nullptr, objective.rules, objective.strategy};
+        evaluateBatch(cache, end - windows[rung], end, rung_objective, survivors);
+        std::sort(survivors.begin(), survivors.end(), [](const StrategyParams& a, const StrategyParams& b) { return a.performance > b.performance; });
+        if (rung + 1 < windows.size()) survivors.resize(std::max<size_t>(1, (size_t)(survivors.size() / schedule.eta)));
+    }
+    return survivors.front();
+}
+// Rolling walk-forward: optimise on wf_train bars, trade the next wf_test bars with those parameters,
+// then slide both windows forward by wf_test. Folds run in parallel over the shared cache, so the total
+// cost is folds x iterations x wf_train rather than growing with the square of the history length.
+WalkForwardResult runWalkForward(const SeriesCache& cache, size_t end, const RunOptions& opts) {
+    WalkForwardResult result;
+    // The first test window starts after the longest warmup any candidate can need.
+    size_t max_warmup = maxWarmupBars(opts.space, opts.strategy, opts.rules);
+    for (size_t train_begin = max_warmup > opts.wf_train ? max_warmup - opts.wf_train : 0; train_begin + opts.wf_train + opts.wf_test <= end; train_begin += opts.wf_test) {
+        size_t test_begin = train_begin + opts.wf_train;
+        result.folds.push_back({train_begin, test_begin, test_begin + opts.wf_test, StrategyParams(), 0.0, 0.0});
+    }
+
+    std::vector<std::vector<double>> fold_equity(result.folds.size());
+    parallelFor(result.folds.size(), [&](size_t k) {
+        WalkForwardFold& f = result.folds[k];
+        f.params = findBestParameters(cache, f.train_begin, f.test_begin, opts);
+        f.in_sample = f.params.performance;
+        // Start the out-of-sample run early enough that the first traded bar is exactly test_begin.
+        size_t warmup = warmupBars(f.params);
+        if (opts.rules.custom) {
+            size_t rule_period = std::max(compileRule(opts.rules.buy, f.params, cache.has_volume).max_period, compileRule(opts.rules.exit, f.params, cache.has_volume).max_period);
+            warmup = std::max(warmup, rule_period + 1);
+        }
+        f.out_of_sample = objectiveValue(simulateBacktestRange(cache, f.params, f.test_begin - std::min(warmup, f.test_begin), f.test_end, &fold_equity[k], nullptr, &opts.rules), opts.objective);
+    });
+
+    double offset = 0;
+    for (const auto& eq : fold_equity) {
+        for (double v : eq) result.equity.push_back(offset + v);
+        if (!eq.empty()) offset += eq.back();
+    }
+    return result;
+}
+// Stateless generator: the value depends only on (seed, stream, counter), so each resample owns a
+// stream and the results are identical whichever thread draws them.
+uint64_t counterRandom(uint64_t seed, uint64_t stream, uint64_t counter) {
+    uint64_t z = seed + stream * 0x9E3779B97F4A7C15ULL + counter * 0xD1B54A32D192ED03ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    return z ^ (z >> 27);
+}
+// Bootstrap the trade sequence: each resample draws trades.size() trades with replacement and records
+// final PnL and max drawdown. Resamples are processed LANES at a time in lockstep so the inner loop is
+// branch-free and vectorisable; the only allocations are the two result arrays.
+MonteCarloSummary runMonteCarlo(const std::vector<double>& trades, int resamples, uint64_t seed) {
+    constexpr int LANES = 8;
+    MonteCarloSummary summary;
+    summary.resamples = resamples;
+    summary.trades = trades.size();
+    if (trades.empty() || resamples <= 0) return summary;
+
+    const size_t n = trades.size();
+    const double* t = trades.data();
+    std::vector<double> pnl(resamples), dd(resamples);
+    size_t n_blocks = (resamples + LANES - 1) / LANES;
+
+    parallelFor(n_blocks, [&](size_t block) {
+        double equity[LANES] = {0}, peak[LANES] = {0}, max_dd[LANES] = {0};
+        uint64_t stream0 = block * LANES;
+        for (size_t j = 0; j < n; ++j) {
+            for (int lane = 0; lane < LANES; ++lane) {
+                uint64_t r = counterRandom(seed, stream0 + lane, j);
+                equity[lane] += t[((r >> 32) * n) >> 32];
+                peak[lane] = std::max(peak[lane], equity[lane]);
+                max_dd[lane] = std::max(max_dd[lane], peak[lane] - equity[lane]);
+            }
+        }
+        for (int lane = 0; lane < LANES; ++lane) {
+            size_t idx = stream0 + lane;
+            if (idx < (size_t)resamples) { pnl[idx] = equity[lane]; dd[idx] = max_dd[lane]; }
+        }
+    });
+
+    auto percentile = [&](std::vector<double>& v, double q) {
+        size_t k = std::min(v.size() - 1, (size_t)(q * (v.size() - 1) + 0.5));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    };
+    summary.pnl_p5 = percentile(pnl, 0.05);
+    summary.pnl_p50 = percentile(pnl, 0.50);
+    summary.pnl_p95 = percentile(pnl, 0.95);
+    summary.dd_p50 = percentile(dd, 0.50);
+    summary.dd_p95 = percentile(dd, 0.95);
+    summary.dd_p99 = percentile(dd, 0.99);
+    return summary;
+}
+// --- Rule Language ---
+// expr    := and ("||" and)*        and := unary ("&&" unary)*      unary := "!" unary | compare
+// compare := sum (op sum)?          op  := > < >= <= == !=
+// sum     := term (("+"|"-") term)* term := factor (("*"|"/") factor)*
+// factor  := number | param | series | fn "(" number|param ")" | "(" expr ")" | "-" factor
+// fn: sma rsi obv; series: close atr atr_pct; params: s l r o (periods), t (rsi_threshold), m (min_atr_percent).
+std::vector<std::string> tokenizeRule(const std::string& text) {
+    std::vector<std::string> tokens;
+    for (size_t i = 0; i < text.size();) {
+        char c = text[i];
+        if (isspace((unsigned char)c)) { ++i; continue; }
+        size_t j = i;
+        if (isdigit((unsigned char)c) || c == '.') { while (j < text.size() && (isdigit((unsigned char)text[j]) || text[j] == '.')) ++j; }
+        else if (isalpha((unsigned char)c) || c == '_') { while (j < text.size() && (isalnum((unsigned char)text[j]) || text[j] == '_')) ++j; }
+        else if (i + 1 < text.size() && std::string("&& || >= <= == !=").find(text.substr(i, 2)) != std::string::npos && text.substr(i, 2).find(' ') == std::string::npos) j = i + 2;
+        else if (std::string("<>!+-*/()").find(c) != std::string::npos) j = i + 1;
+        else throw std::runtime_error(std::string("unexpected character '") + c + "'");
+        tokens.push_back(text.substr(i, j - i));
+        i = j;
+    }
+    return tokens;
+}
+RuleNode parseRuleExpr(const std::vector<std::string>& tok, size_t& pos);
+bool ruleAccept(const std::vector<std::string>& tok, size_t& pos, const std::string& t) {
+    if (pos < tok.size() && tok[pos] == t) { ++pos; return true; }
+    return false;
+}
+RuleNode parseRuleFactor(const std::vector<std::string>& tok, size_t& pos) {
+    if (pos >= tok.size()) throw std::runtime_error("unexpected end of rule");
+    std::string t = tok[pos++];
+    if (t == "(") {
+        RuleNode inner = parseRuleExpr(tok, pos);
+        if (!ruleAccept(tok, pos, ")")) throw std::runtime_error("missing ')'");
+        return inner;
+    }
+    if (t == "-") return {"neg", "", 0, {parseRuleFactor(tok, pos)}};
+    if (isdigit((unsigned char)t[0]) || t[0] == '.') return {"num", "", std::stod(t), {}};
+    if (t == "sma" || t == "rsi" || t == "obv") {
+        if (!ruleAccept(tok, pos, "(") || pos >= tok.size()) throw std::runtime_error(t + " needs a period argument");
+        RuleNode arg = parseRuleFactor(tok, pos);
+        if (!ruleAccept(tok, pos, ")")) throw std::runtime_error("missing ')' after " + t + "(...");
+        bool period_param = arg.kind == "param" && (arg.name == "s" || arg.name == "l" || arg.name == "r" || arg.name == "o");
+        if (!period_param && !(arg.kind == "num" && arg.value >= 1 && arg.value == std::floor(arg.value)))
+            throw std::runtime_error(t + "() takes a whole number >= 1 or one of s, l, r, o");
+        return {"call", t, 0, {arg}};
+    }
+    if (t == "close" || t == "atr" || t == "atr_pct") return {"series", t, 0, {}};
+    if (t == "s" || t == "l" || t == "r" || t == "o" || t == "t" || t == "m") return {"param", t, 0, {}};
+    throw std::runtime_error("unknown name '" + t + "'");
+}
+RuleNode parseRuleTerm(const std::vector<std::string>& tok, size_t& pos) {
+    RuleNode node = parseRuleFactor(tok, pos);
+    while (pos < tok.size() && (tok[pos] == "*" || tok[pos] == "/")) {
+        std::string op = tok[pos++];
+        node = {"bin", op, 0, {node, parseRuleFactor(tok, pos)}};
+    }
+    return node;
+}
+RuleNode parseRuleSum(const std::vector<std::string>& tok, size_t& pos) {
+    RuleNode node = parseRuleTerm(tok, pos);
+    while (pos < tok.size() && (tok[pos] == "+" || tok[pos] == "-")) {
+        std::string op = tok[pos++];
+        node = {"bin", op, 0, {node, parseRuleTerm(tok, pos)}};
+    }
+    return node;
+}
+RuleNode parseRuleCompare(const std::vector<std::string>& tok, size_t& pos) {
+    RuleNode node = parseRuleSum(tok, pos);
+    static const std::vector<std::string> ops = {">", "<", ">=", "<=", "==", "!="};
+    if (pos < tok.size() && std::find(ops.begin(), ops.end(), tok[pos]) != ops.end()) {
+        std::string op = tok[pos++];
+        node = {"cmp", op, 0, {node, parseRuleSum(tok, pos)}};
+    }
+    return node;
+}
+RuleNode parseRuleUnary(const std::vector<std::string>& tok, size_t& pos) {
+    if (ruleAccept(tok, pos, "!")) return {"not", "", 0, {parseRuleUnary(tok, pos)}};
+    return parseRuleCompare(tok, pos);
+}
+RuleNode parseRuleAnd(const std::vector<std::string>& tok, size_t& pos) {
+    RuleNode node = parseRuleUnary(tok, pos);
+    while (ruleAccept(tok, pos, "&&")) node = {"bin", "&&", 0, {node, parseRuleUnary(tok, pos)}};
+    return node;
+}
+RuleNode parseRuleExpr(const std::vector<std::string>& tok, size_t& pos) {
+    RuleNode node = parseRuleAnd(tok, pos);
+    while (ruleAccept(tok, pos, "||")) node = {"bin", "||", 0, {node, parseRuleAnd(tok, pos)}};
+    return node;
+}
+RuleNode parseRule(const std::string& text) {
+    std::vector<std::string> tok = tokenizeRule(text);
+    size_t pos = 0;
+    RuleNode node = parseRuleExpr(tok, pos);
+    if (pos != tok.size()) throw std::runtime_error("unexpected '" + tok[pos] + "'");
+    return node;
+}
+// "rule buy|sell|exit <expr>" lines in the config replace the default rules. buy/sell drive the live
+// signal; the (long-only) backtest enters on buy and leaves on exit.
+bool readRuleSet(const std::string& file, RuleSet& rules) {
     std::ifstream f(file);
     std::string line;
-    getline(f, line); // Skip header
     while (getline(f, line)) {
-        std::stringstream ss(line);
-        std::string dt, o, h, l, c, ac, v, atr_str;
-        getline(ss, dt, ',');
-        getline(ss, o, ',');
-        getline(ss, h, ',');
-        getline(ss, l, ',');
-        getline(ss, c, ',');
-        getline(ss, ac, ',');
-        getline(ss, v, ',');
-        getline(ss, atr_str, ',');
-        if (o.empty() || c.empty()) continue;
+        if (line.rfind("rule ", 0) != 0) continue;
+        std::stringstream ss(line.substr(5));
+        std::string which, text;
+        ss >> which;
+        getline(ss, text);
+        if (which == "buy") rules.buy_text = text;
+        else if (which == "sell") rules.sell_text = text;
+        else if (which == "exit") rules.exit_text = text;
+        else {
+            std::cerr << "Unknown rule '" << which << "' in " << file << " (expected buy, sell or exit)" << std::endl;
+            return false;
+        }
+        rules.custom = true;
+    }
+    try {
+        rules.buy = parseRule(rules.buy_text);
+        rules.sell = parseRule(rules.sell_text);
+        rules.exit = parseRule(rules.exit_text);
+        StrategyParams probe;
+        for (const RuleNode* n : {&rules.buy, &rules.sell, &rules.exit}) compileRule(*n, probe, true);
+    } catch (const std::exception& e) {
+        std::cerr << "Bad rule in " << file << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+int ruleParamPeriod(const RuleNode& arg, const StrategyParams& p) {
+    if (arg.kind == "num") return (int)arg.value;
+    if (arg.name == "s") return p.sma_short;
+    if (arg.name == "l") return p.sma_long;
+    if (arg.name == "r") return p.rsi_period;
+    return p.obv_period;
+}
+bool ruleConstant(const RuleNode& node, const StrategyParams& p, double& out) {
+    if (node.kind == "num") { out = node.value; return true; }
+    if (node.kind == "param") {
+        if (node.name == "t") out = p.rsi_threshold;
+        else if (node.name == "m") out = p.min_atr_percent;
+        else out = ruleParamPeriod(node, p);
+        return true;
+    }
+    double a, b;
+    if (node.kind == "neg" && ruleConstant(node.args[0], p, a)) { out = -a; return true; }
+    if (node.kind == "bin" && node.name.size() == 1 && ruleConstant(node.args[0], p, a) && ruleConstant(node.args[1], p, b)) {
+        out = node.name == "+" ? a + b : node.name == "-" ? a - b : node.name == "*" ? a * b : a / b;
+        return true;
+    }
+    return false;
+}
+bool ruleSeries(const RuleNode& node, const StrategyParams& p, RuleSeries& series, int& period) {
+    period = 0;
+    if (node.kind == "series") {
+        series = node.name == "close" ? RuleSeries::Close : node.name == "atr" ? RuleSeries::Atr : RuleSeries::AtrPercent;
+        return true;
+    }
+    if (node.kind != "call") return false;
+    series = node.name == "sma" ? RuleSeries::Sma : node.name == "rsi" ? RuleSeries::Rsi : RuleSeries::Obv;
+    period = ruleParamPeriod(node.args[0], p);
+    return true;
+}
+bool ruleUsesObv(const RuleNode& node) {
+    if (node.kind == "call" && node.name == "obv") return true;
+    for (const auto& a : node.args) if (ruleUsesObv(a)) return true;
+    return false;
+}
+RuleCmp ruleCmpOf(const std::string& op) {
+    if (op == ">") return RuleCmp::Gt;
+    if (op == "<") return RuleCmp::Lt;
+    if (op == ">=") return RuleCmp::Ge;
+    if (op == "<=") return RuleCmp::Le;
+    if (op == "==") return RuleCmp::Eq;
+    return RuleCmp::Ne;
+}
+void emitRule(const RuleNode& node, const StrategyParams& p, bool has_volume, RuleProgram& prog) {
+    RuleInstr in{RuleOp::Const};
+    RuleSeries ls, rs;
+    int lp, rp;
+    double k;
+    if (ruleConstant(node, p, k)) {
+        in.k = k;
+    } else if (ruleSeries(node, p, ls, lp)) {
+        in.op = RuleOp::Load; in.lhs = ls; in.lhs_period = lp;
+    } else if (node.kind == "cmp" && !has_volume && ruleUsesObv(node)) {
+        in.k = 1.0;  // without volume data OBV filters are dropped, as the live signal always did
+    } else if (node.kind == "cmp" && ruleSeries(node.args[0], p, ls, lp) && ruleSeries(node.args[1], p, rs, rp)) {
+        in.op = RuleOp::LoadCmpLoad; in.cmp = ruleCmpOf(node.name); in.lhs = ls; in.lhs_period = lp; in.rhs = rs; in.rhs_period = rp;
+    } else if (node.kind == "cmp" && ruleSeries(node.args[0], p, ls, lp) && ruleConstant(node.args[1], p, k)) {
+        in.op = RuleOp::LoadCmpConst; in.cmp = ruleCmpOf(node.name); in.lhs = ls; in.lhs_period = lp; in.k = k;
+    } else if (node.kind == "bin" && (node.name == "&&" || node.name == "||")) {
+        // Short-circuit: the jump leaves the deciding value on the stack, otherwise it is popped.
+        emitRule(node.args[0], p, has_volume, prog);
+        size_t jump_at = prog.code.size();
+        prog.code.push_back({node.name == "&&" ? RuleOp::JumpIfFalse : RuleOp::JumpIfTrue});
+        emitRule(node.args[1], p, has_volume, prog);
+        prog.code[jump_at].jump = (int)prog.code.size();
+        return;
+    } else if (node.kind == "neg" || node.kind == "not") {
+        emitRule(node.args[0], p, has_volume, prog);
+        in.op = node.kind == "neg" ? RuleOp::Neg : RuleOp::Not;
+    } else {
+        emitRule(node.args[0], p, has_volume, prog);
+        emitRule(node.args[1], p, has_volume, prog);
+        if (node.kind == "cmp") { in.op = RuleOp::Compare; in.cmp = ruleCmpOf(node.name); }
+        else in.op = node.name == "+" ? RuleOp::Add : node.name == "-" ? RuleOp::Sub : node.name == "*" ? RuleOp::Mul : RuleOp::Div;
+    }
+    if (in.op == RuleOp::Load || in.op == RuleOp::LoadCmpLoad || in.op == RuleOp::LoadCmpConst)
+        prog.max_period = std::max({prog.max_period, in.lhs_period, in.op == RuleOp::LoadCmpLoad ? in.rhs_period : 0});
+    prog.code.push_back(in);
+}
+constexpr int RULE_STACK = 32;
+// Periods are resolved to immediates and common comparisons are fused into single instructions, so
+// the program is compiled per parameter set (it is a handful of instructions).
+RuleProgram compileRule(const RuleNode& node, const StrategyParams& params, bool has_volume) {
+    RuleProgram prog;
+    emitRule(node, params, has_volume, prog);
+    int depth = 0, max_depth = 0;
+    for (const auto& in : prog.code) {
+        if (in.op == RuleOp::Const || in.op == RuleOp::Load || in.op == RuleOp::LoadCmpLoad || in.op == RuleOp::LoadCmpConst) ++depth;
+        else if (in.op != RuleOp::Neg && in.op != RuleOp::Not) --depth;
+        max_depth = std::max(max_depth, depth);
+    }
+    if (max_depth > RULE_STACK) throw std::runtime_error("rule nests too deeply");
+    return prog;
+}
+inline double ruleSeriesValue(const SeriesCache& c, RuleSeries series, int p, size_t i) {
+    switch (series) {
+        case RuleSeries::Sma: return (c.close_sum[i+1] - c.close_sum[i+1-p]) / p;
+        case RuleSeries::Rsi: {
+            double loss = c.loss_sum[i+1] - c.loss_sum[i+1-p];
+            return (loss == 0) ? 100.0 : 100.0 - (100.0 / (1.0 + (c.gain_sum[i+1] - c.gain_sum[i+1-p]) / loss));
+        }
+        case RuleSeries::Obv: return (c.obv[i] > c.obv[i+1-p]) - (c.obv[i] < c.obv[i+1-p]);
+        case RuleSeries::Close: return c.closes[i];
+        case RuleSeries::Atr: return c.atr[i];
+        case RuleSeries::AtrPercent: return c.atr_percent[i];
+    }
+    return 0;
+}
+inline bool ruleCompare(RuleCmp cmp, double a, double b) {
+    switch (cmp) {
+        case RuleCmp::Gt: return a > b;
+        case RuleCmp::Lt: return a < b;
+        case RuleCmp::Ge: return a >= b;
+        case RuleCmp::Le: return a <= b;
+        case RuleCmp::Eq: return a == b;
+        case RuleCmp::Ne: return a != b;
+    }
+    return false;
+}
+double evalRule(const RuleProgram& prog, const SeriesCache& cache, size_t i) {
+    double stack[RULE_STACK];
+    int sp = 0;
+    const RuleInstr* code = prog.code.data();
+    const int n = (int)prog.code.size();
+    for (int pc = 0; pc < n; ++pc) {
+        const RuleInstr& in = code[pc];
+        switch (in.op) {
+            case RuleOp::Const: stack[sp++] = in.k; break;
+            case RuleOp::Load: stack[sp++] = ruleSeriesValue(cache, in.lhs, in.lhs_period, i); break;
+            case RuleOp::LoadCmpLoad:
+                stack[sp++] = ruleCompare(in.cmp, ruleSeriesValue(cache, in.lhs, in.lhs_period, i), ruleSeriesValue(cache, in.rhs, in.rhs_period, i));
+                break;
+            case RuleOp::LoadCmpConst: stack[sp++] = ruleCompare(in.cmp, ruleSeriesValue(cache, in.lhs, in.lhs_period, i), in.k); break;
+            case RuleOp::Add: --sp; stack[sp-1] += stack[sp]; break;
+            case RuleOp::Sub: --sp; stack[sp-1] -= stack[sp]; break;
+            case RuleOp::Mul: --sp; stack[sp-1] *= stack[sp]; break;
+            case RuleOp::Div: --sp; stack[sp-1] /= stack[sp]; break;
+            case RuleOp::Neg: stack[sp-1] = -stack[sp-1]; break;
+            case RuleOp::Not: stack[sp-1] = (stack[sp-1] == 0); break;
+            case RuleOp::Compare: --sp; stack[sp-1] = ruleCompare(in.cmp, stack[sp-1], stack[sp]); break;
+            case RuleOp::JumpIfFalse: if (stack[sp-1] == 0) pc = in.jump - 1; else --sp; break;
+            case RuleOp::JumpIfTrue: if (stack[sp-1] != 0) pc = in.jump - 1; else --sp; break;
+        }
+    }
+    return stack[0];
+}
+
+// Parses the CSV. The file is read in one go and cut into newline-aligned chunks (about 1 MB or more
+// each, at most one per core, or `threads` if given) that are parsed concurrently and stitched back in
+// order. With stats, the same pass also records what was rejected and why, whether there is any volume,
+// the price and time range, and the ordering: bars further apart than stats->step (if the caller set
+// it) count as gaps, and rows older than their predecessor as out of order. Those are put right by a
+// radix sort on the timestamps, after which duplicate timestamps keep their last row.
+std::vector<Candle> readData(const std::string& file, SeriesStats* stats, size_t threads) {
+    SeriesStats local;
+    SeriesStats& st = stats ? *stats : local;
+    std::vector<Candle> candles;
+    std::ifstream f(file, std::ios::binary | std::ios::ate);
+    if (!f) return candles;
+    std::string text((size_t)f.tellg(), '\0');
+    f.seekg(0);
+    f.read(&text[0], text.size());
+    std::vector<CsvChunk> chunks;
+    if (isColumnarFile(file)) {
+        // Same chunks as a CSV, one per archive block, so the checks below apply unchanged.
+        if (!readColumnar(text, chunks, st.step, threads)) {
+            std::cerr << file << ": not a valid .scol archive" << std::endl;
+            return candles;
+        }
+    } else {
+        const char* end = text.data() + text.size();
+        const char* body = (const char*)memchr(text.data(), '\n', text.size());  // Skip header
+        if (!body) return candles;
+        body++;
+
+        const size_t MIN_CHUNK = 1 << 20;
+        size_t n_chunks = std::min<size_t>(threads ? threads : std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(1, (end - body) / MIN_CHUNK));
+        chunks.resize(n_chunks);
+        const char* cut = body;
+        for (size_t k = 0; k < n_chunks; ++k) {
+            chunks[k].begin = cut;
+            if (k + 1 == n_chunks) cut = end;
+            else {
+                cut = std::max(cut, body + (end - body) * (k + 1) / n_chunks);
+                const char* nl = cut < end ? (const char*)memchr(cut, '\n', end - cut) : nullptr;
+                cut = nl ? nl + 1 : end;
+            }
+            chunks[k].end = cut;
+        }
+        parallelFor(n_chunks, [&](size_t k) { parseCsvChunk(chunks[k], st.step); });
+    }
+
+    // Stitch in file order; a chunk boundary is checked like any other pair of adjacent rows.
+    size_t total = 0;
+    for (const auto& c : chunks) total += c.candles.size();
+    candles.reserve(total);
+    int64_t last_time = INT64_MIN;
+    bool repeated = false;
+    for (auto& c : chunks) {
+        mergeChunkStats(st, c, last_time, repeated);
+        std::move(c.candles.begin(), c.candles.end(), std::back_inserter(candles));
+        std::vector<Candle>().swap(c.candles);
+    }
+
+    // Order can only be repaired when every row has a time.
+    if ((st.out_of_order > 0 || repeated) && st.untimestamped == 0) {
+        if (st.out_of_order > 0) sortByTimestamp(candles);
+        st.sorted = st.out_of_order > 0;
+        size_t kept = 0;
+        st.gaps = 0;
+        for (size_t i = 0; i < candles.size(); ++i) {
+            if (kept > 0 && candles[kept-1].timestamp == candles[i].timestamp) {
+                st.duplicates++;
+                candles[kept-1] = std::move(candles[i]);
+                continue;
+            }
+            if (kept > 0 && st.step > 0 && candles[i].timestamp - candles[kept-1].timestamp > st.step) st.gaps++;
+            if (kept != i) candles[kept] = std::move(candles[i]);
+            kept++;
+        }
+        candles.resize(kept);
+    }
+    if (!candles.empty()) {
+        st.first_time = candles.front().timestamp;
+        st.last_time = candles.back().timestamp;
+    }
+    return candles;
+}
+// One CSV field as a number, with exactly std::stod/std::stoll's rules (same strtod/strtoll, no
+// conversion or out of range is a failure). The common case, a plain number filling the field, goes
+// through from_chars, which rounds exactly like strtod; anything else (spaces, a sign, trailing text,
+// hex, zero/subnormal/inf) is left to strtod on a terminated copy of the field.
+bool csvNumber(const char* s, size_t n, double& out) {
+    auto fast = std::from_chars(s, s + n, out);
+    if (fast.ec == std::errc() && fast.ptr == s + n && std::isnormal(out)) return true;
+    char buf[64];
+    if (n == 0 || n >= sizeof(buf)) return n != 0 && csvNumber(std::string(s, n), out);
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    char* stop;
+    errno = 0;
+    out = strtod(buf, &stop);
+    return stop != buf && errno != ERANGE;
+}
+bool csvNumber(const char* s, size_t n, long long& out) {
+    auto fast = std::from_chars(s, s + n, out);
+    if (fast.ec == std::errc() && fast.ptr == s + n) return true;
+    char buf[64];
+    if (n == 0 || n >= sizeof(buf)) return n != 0 && csvNumber(std::string(s, n), out);
+    memcpy(buf, s, n);
+    buf[n] = '\0';
+    char* stop;
+    errno = 0;
+    out = strtoll(buf, &stop, 10);
+    return stop != buf && errno != ERANGE;
+}
+bool csvNumber(const std::string& s, double& out) {
+    char* stop;
+    errno = 0;
+    out = strtod(s.c_str(), &stop);
+    return stop != s.c_str() && errno != ERANGE;
+}
+bool csvNumber(const std::string& s, long long& out) {
+    char* stop;
+    errno = 0;
+    out = strtoll(s.c_str(), &stop, 10);
+    return stop != s.c_str() && errno != ERANGE;
+}
+// Folds one chunk's statistics into the file's, checking the seam with the previous chunk like any other
+// pair of adjacent rows; last_time and repeated carry from call to call.
+void mergeChunkStats(SeriesStats& st, const CsvChunk& c, int64_t& last_time, bool& repeated) {
+    st.rows += c.stats.rows;
+    for (const auto& r : c.stats.rejected) st.rejected[r.first] += r.second;
+    st.has_volume = st.has_volume || c.stats.has_volume;
+    st.untimestamped += c.stats.untimestamped;
+    st.out_of_order += c.stats.out_of_order;
+    st.gaps += c.stats.gaps;
+    st.min_price = std::min(st.min_price, c.stats.min_price);
+    st.max_price = std::max(st.max_price, c.stats.max_price);
+    repeated = repeated || c.repeated;
+    if (c.first_time != INT64_MIN && last_time != INT64_MIN) {
+        if (c.first_time < last_time) st.out_of_order++;
+        else if (c.first_time == last_time) repeated = true;
+        else if (st.step > 0 && c.first_time - last_time > st.step) st.gaps++;
+    }
+    if (c.last_time != INT64_MIN) last_time = c.last_time;
+}
+// Parses the rows in [chunk.begin, chunk.end) into chunk.candles and chunk.stats. Columns are
+// Datetime,Open,High,Low,Close,Adj Close,Volume,ATR; missing trailing fields read as empty.
+void parseCsvChunk(CsvChunk& chunk, int64_t step) {
+    SeriesStats& st = chunk.stats;
+    int64_t last_time = INT64_MIN;
+    const char* first_eol = (const char*)memchr(chunk.begin, '\n', chunk.end - chunk.begin);
+    if (first_eol) chunk.candles.reserve((chunk.end - chunk.begin) / (first_eol - chunk.begin + 1) + 16);
+    for (const char* p = chunk.begin; p < chunk.end; ) {
+        const char* eol = (const char*)memchr(p, '\n', chunk.end - p);
+        if (!eol) eol = chunk.end;
+        st.rows++;
+        const char* field[8];
+        size_t len[8];
+        const char* q = p;
+        for (int k = 0; k < 8; ++k) {
+            const char* comma = q < eol ? (const char*)memchr(q, ',', eol - q) : nullptr;
+            const char* stop = comma ? comma : eol;
+            field[k] = q;
+            len[k] = stop - q;
+            q = comma ? comma + 1 : eol;
+        }
+        p = eol + 1;
+        if (len[1] == 0 || len[4] == 0) { st.rejected["missing price"]++; continue; }
+        Candle candle;
+        if (!csvNumber(field[1], len[1], candle.open) || !csvNumber(field[2], len[2], candle.high) || !csvNumber(field[3], len[3], candle.low)
+            || !csvNumber(field[4], len[4], candle.close) || !csvNumber(field[6], len[6], candle.volume) || !csvNumber(field[7], len[7], candle.atr)) {
+            st.rejected["unparseable number"]++;
+            continue;
+        }
+        candle.datetime.assign(field[0], len[0]);
+        candle.timestamp = parseTimestamp(candle.datetime);
+        addRowStats(chunk, candle, last_time, step);
+        chunk.candles.push_back(std::move(candle));
+    }
+    chunk.last_time = last_time;
+}
+// Statistics for one accepted row, checked against the chunk's previous timestamped row (last_time).
+void addRowStats(CsvChunk& chunk, const Candle& candle, int64_t& last_time, int64_t step) {
+    SeriesStats& st = chunk.stats;
+    if (candle.volume > 0) st.has_volume = true;
+    st.min_price = std::min(st.min_price, candle.low);
+    st.max_price = std::max(st.max_price, candle.high);
+    if (candle.timestamp < 0) {
+        st.untimestamped++;
+        return;
+    }
+    if (last_time != INT64_MIN) {
+        if (candle.timestamp < last_time) st.out_of_order++;
+        else if (candle.timestamp == last_time) chunk.repeated = true;
+        else if (step > 0 && candle.timestamp - last_time > step) st.gaps++;
+    }
+    if (chunk.first_time == INT64_MIN) chunk.first_time = candle.timestamp;
+    last_time = candle.timestamp;
+}
+// Stable LSD radix sort by timestamp, one byte per pass and only as many passes as the time span needs.
+// The keys and an index are sorted side by side; the candles (strings and all) are then moved into place
+// by following the permutation's cycles, so they are never copied into a second buffer.
+void sortByTimestamp(std::vector<Candle>& candles) {
+    size_t n = candles.size();
+    if (n < 2) return;
+    int64_t lo = candles[0].timestamp, hi = lo;
+    for (const auto& c : candles) { lo = std::min(lo, c.timestamp); hi = std::max(hi, c.timestamp); }
+    std::vector<uint64_t> key(n), key_tmp(n);
+    std::vector<uint32_t> order(n), order_tmp(n);
+    for (size_t i = 0; i < n; ++i) { key[i] = (uint64_t)(candles[i].timestamp - lo); order[i] = (uint32_t)i; }
+    for (int shift = 0; shift < 64 && ((uint64_t)(hi - lo) >> shift) != 0; shift += 8) {
+        size_t count[257] = {0};
+        for (size_t i = 0; i < n; ++i) count[((key[i] >> shift) & 0xFF) + 1]++;
+        for (int b = 0; b < 256; ++b) count[b+1] += count[b];
+        for (size_t i = 0; i < n; ++i) {
+            size_t dst = count[(key[i] >> shift) & 0xFF]++;
+            key_tmp[dst] = key[i];
+            order_tmp[dst] = order[i];
+        }
+        key.swap(key_tmp);
+        order.swap(order_tmp);
+    }
+    // order[k] is the candle that belongs at k.
+    for (size_t start = 0; start < n; ++start) {
+        if (order[start] == start) continue;
+        Candle held = std::move(candles[start]);
+        size_t k = start;
+        while (order[k] != start) {
+            size_t from = order[k];
+            candles[k] = std::move(candles[from]);
+            order[k] = (uint32_t)k;
+            k = from;
+        }
+        candles[k] = std::move(held);
+        order[k] = (uint32_t)k;
+    }
+}
+// "YYYY-MM-DD HH:MM:SS" (as written by the fetch script) to seconds since the epoch, -1 if malformed.
+int64_t parseTimestamp(const std::string& datetime) {
+    int y, mo, d, h = 0, mi = 0, sec = 0;
+    const char* t = datetime.c_str();
+    auto digits = [t](int at, int n) { int v = 0; for (int k = at; k < at + n; ++k) v = v * 10 + (t[k] - '0'); return v; };
+    bool fixed = datetime.size() >= 19 && t[4] == '-' && t[7] == '-' && t[10] == ' ' && t[13] == ':' && t[16] == ':';
+    for (int k : {0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, 17, 18}) fixed = fixed && t[k] >= '0' && t[k] <= '9';
+    if (fixed) {
+        // The fetch script's exact layout, without sscanf (the bulk of parsing time on large files).
+        y = digits(0, 4); mo = digits(5, 2); d = digits(8, 2); h = digits(11, 2); mi = digits(14, 2); sec = digits(17, 2);
+    } else if (sscanf(t, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &sec) < 3) return -1;
+    // Days from civil (proleptic Gregorian), so no time zone or libc calendar gets involved.
+    y -= mo <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (mo + (mo > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = era * 146097 + doe - 719468;
+    return days * 86400 + h * 3600 + mi * 60 + sec;
+}
+// Inverse of parseTimestamp for the canonical layout: writes exactly 19 chars "YYYY-MM-DD HH:MM:SS".
+// The date part is only recomputed when the day changes (cached_day), which is rare on intraday bars.
+void formatTimestamp(int64_t ts, char* out, int64_t& cached_day) {
+    int64_t days = (ts >= 0 ? ts : ts - 86399) / 86400, secs = ts - days * 86400;
+    if (days != cached_day) {
+        cached_day = days;
+        // Civil from days, the mirror of parseTimestamp's arithmetic.
+        int64_t z = days + 719468;
+        int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        int64_t doe = z - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp = (5 * doy + 2) / 153;
+        int64_t d = doy - (153 * mp + 2) / 5 + 1, m = mp < 10 ? mp + 3 : mp - 9, y = yoe + era * 400 + (m <= 2);
+        if (y < 0 || y > 9999) y = 0;  // not representable; the encoder's round-trip check refuses it
+        out[0] = '0' + y / 1000; out[1] = '0' + y / 100 % 10; out[2] = '0' + y / 10 % 10; out[3] = '0' + y % 10;
+        out[4] = '-'; out[5] = '0' + m / 10; out[6] = '0' + m % 10; out[7] = '-'; out[8] = '0' + d / 10; out[9] = '0' + d % 10;
+        out[10] = ' '; out[13] = ':'; out[16] = ':';
+    }
+    int h = secs / 3600, mi = secs / 60 % 60, s = secs % 60;
+    out[11] = '0' + h / 10; out[12] = '0' + h % 10; out[14] = '0' + mi / 10; out[15] = '0' + mi % 10; out[17] = '0' + s / 10; out[18] = '0' + s % 10;
+}
+
+// --- Columnar archive (.scol) ---
+// Header: "SCOL", u32 version, u64 rows, u32 block_rows, u32 blocks, then one u64 file offset per block
+// so blocks decode independently (and in parallel). A block is u32 rows followed by the columns
+// timestamp, open, high, low, close, volume, atr, each as u8 encoding, u32 payload bytes, payload.
+//   timestamps: first value and first delta as zigzag varints, then the delta-of-deltas (zero on a
+//               regular grid) as a PFOR column
+//   prices/atr: scaled integers when every value in the block is exactly k / 10^d for one d <= 9 (first
+//               value as a zigzag varint, then zigzag deltas as PFOR), otherwise Gorilla XOR on the bits
+//   volume:     zigzag varints
+// PFOR packs every value in w bits (w picked per column to minimise size), LSB-first and followed by 8
+// zero bytes so the decoder can read any value with one unaligned 64-bit load and no branches; values
+// wider than w are patched in afterwards from a list of (index delta, high bits) varints. Integers are
+// little-endian. Adj Close is not stored (nothing reads it).
+const uint32_t SCOL_VERSION = 1;
+const size_t SCOL_BLOCK_ROWS = 8192;
+bool isColumnarFile(const std::string& file) {
+    return file.size() > 5 && file.compare(file.size() - 5, 5, ".scol") == 0;
+}
+// <TICKER>.scol when it is at least as new as <TICKER>.csv (or there is no CSV), otherwise the CSV, so a
+// fetch after the last compress is never shadowed by the stale archive.
+std::string tickerDataFile(const std::string& ticker) {
+    struct stat scol, csv;
+    if (stat((ticker + ".scol").c_str(), &scol) != 0) return ticker + ".csv";
+    if (stat((ticker + ".csv").c_str(), &csv) != 0) return ticker + ".scol";
+    bool fresh = scol.st_mtim.tv_sec != csv.st_mtim.tv_sec ? scol.st_mtim.tv_sec > csv.st_mtim.tv_sec : scol.st_mtim.tv_nsec >= csv.st_mtim.tv_nsec;
+    return fresh ? ticker + ".scol" : ticker + ".csv";
+}
+uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) { out.push_back((char)(v | 0x80)); v >>= 7; }
+    out.push_back((char)v);
+}
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (b < 0x80) return true;
+    }
+    return false;
+}
+template <class T> void putFixed(std::string& out, T v) { out.append((const char*)&v, sizeof(T)); }
+template <class T> bool getFixed(const uint8_t*& p, const uint8_t* end, T& v) {
+    if (end - p < (ptrdiff_t)sizeof(T)) return false;
+    memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+// LSB-first bit stream shared by PFOR and Gorilla. n <= 32 per putBits call; readBits takes n <= 56.
+void putBits(BitWriter& w, uint64_t v, int n) {
+    w.acc |= (v & ((1ull << n) - 1)) << w.bits;
+    w.bits += n;
+    while (w.bits >= 8) { w.bytes.push_back((char)w.acc); w.acc >>= 8; w.bits -= 8; }
+}
+void putWideBits(BitWriter& w, uint64_t v, int n) {
+    if (n > 32) { putBits(w, v, 32); putBits(w, v >> 32, n - 32); }
+    else putBits(w, v, n);
+}
+void finishBits(BitWriter& w) {
+    if (w.bits > 0) w.bytes.push_back((char)w.acc);
+    w.bytes.append(8, '\0');  // padding for readBits' 64-bit loads
+    w.acc = 0;
+    w.bits = 0;
+}
+uint64_t readBits(const uint8_t* data, size_t bit, int n) {
+    uint64_t word;
+    memcpy(&word, data + (bit >> 3), 8);
+    return (word >> (bit & 7)) & ((1ull << n) - 1);
+}
+uint64_t readWideBits(const uint8_t* data, size_t& bit, int n) {
+    uint64_t v = n > 32 ? readBits(data, bit, 32) | readBits(data, bit + 32, n - 32) << 32 : readBits(data, bit, n);
+    bit += n;
+    return v;
+}
+void putPfor(std::string& out, const std::vector<uint64_t>& values) {
+    // Width by estimated size: every value costs w bits, every exception ~1 byte of index plus its high bits.
+    size_t by_width[65] = {0};
+    for (uint64_t v : values) by_width[v ? 64 - __builtin_clzll(v) : 0]++;
+    int best_w = 0;
+    double best_cost = INFINITY;
+    for (int w = 0; w <= 56; ++w) {
+        double cost = (double)values.size() * w;
+        for (int b = w + 1; b <= 64; ++b) cost += by_width[b] * (8.0 + 8.0 * ((b - w + 6) / 7));
+        if (cost < best_cost) { best_cost = cost; best_w = w; }
+    }
+    size_t exceptions = 0;
+    for (int b = best_w + 1; b <= 64; ++b) exceptions += by_width[b];
+    out.push_back((char)best_w);
+    putVarint(out, exceptions);
+    BitWriter bits;
+    for (uint64_t v : values) putBits(bits, v, best_w);
+    finishBits(bits);
+    out += bits.bytes;
+    size_t last = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] >> best_w == 0) continue;
+        putVarint(out, i - last);
+        putVarint(out, values[i] >> best_w);
+        last = i;
+    }
+}
+bool getPfor(const uint8_t*& p, const uint8_t* end, size_t n, uint64_t* values) {
+    uint64_t exceptions;
+    if (p >= end) return false;
+    int w = *p++;
+    if (w > 56 || !getVarint(p, end, exceptions)) return false;
+    size_t packed = (n * w + 7) / 8 + 8;
+    if ((size_t)(end - p) < packed) return false;
+    for (size_t i = 0; i < n; ++i) values[i] = readBits(p, i * w, w);  // fixed width, no branches
+    p += packed;
+    size_t at = 0;
+    for (uint64_t e = 0; e < exceptions; ++e) {
+        uint64_t delta, high;
+        if (!getVarint(p, end, delta) || !getVarint(p, end, high) || (at += delta) >= n) return false;
+        values[at] |= high << w;
+    }
+    return true;
+}
+// Smallest d such that every value round-trips bit for bit through llround(x * 10^d) / 10^d, or -1.
+int scaledDigits(const double* x, size_t n) {
+    static const double POW10[10] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    for (int d = 0; d < 10; ++d) {
+        bool exact = true;
+        for (size_t i = 0; i < n && exact; ++i) {
+            double scaled = x[i] * POW10[d];
+            double back = std::fabs(scaled) < 4e15 ? (double)std::llround(scaled) / POW10[d] : NAN;
+            exact = memcmp(&back, &x[i], 8) == 0;  // bitwise, so -0.0 and NaN fall through to Gorilla
+        }
+        if (exact) return d;
+    }
+    return -1;
+}
+void putDoubleColumn(std::string& out, const std::vector<double>& x) {
+    static const double POW10[10] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    std::string payload;
+    int d = scaledDigits(x.data(), x.size());
+    if (d >= 0) {
+        payload.push_back((char)d);
+        int64_t prev = std::llround(x[0] * POW10[d]);
+        putVarint(payload, zigzag(prev));
+        std::vector<uint64_t> deltas(x.size() - 1);
+        for (size_t i = 1; i < x.size(); ++i) {
+            int64_t v = std::llround(x[i] * POW10[d]);
+            deltas[i-1] = zigzag(v - prev);
+            prev = v;
+        }
+        putPfor(payload, deltas);
+    } else {
+        // Gorilla: XOR with the previous value's bits; '0' if unchanged, '10' + the meaningful bits if they
+        // fit the previous leading/trailing-zero window, else '11' + 5-bit leading zeros + 6-bit length + bits.
+        BitWriter bits;
+        uint64_t prev;
+        memcpy(&prev, &x[0], 8);
+        putWideBits(bits, prev, 64);
+        int lead = -1, len = 0;
+        for (size_t i = 1; i < x.size(); ++i) {
+            uint64_t v;
+            memcpy(&v, &x[i], 8);
+            uint64_t diff = v ^ prev;
+            prev = v;
+            if (diff == 0) { putBits(bits, 0, 1); continue; }
+            int lz = std::min(31, __builtin_clzll(diff)), tz = __builtin_ctzll(diff);
+            if (lead >= 0 && lz >= lead && tz >= 64 - lead - len) {
+                putBits(bits, 1, 2);
+                putWideBits(bits, diff >> (64 - lead - len), len);
+            } else {
+                lead = lz;
+                len = 64 - lz - tz;
+                putBits(bits, 3, 2);
+                putBits(bits, lead, 5);
+                putBits(bits, len - 1, 6);
+                putWideBits(bits, diff >> tz, len);
+            }
+        }
+        finishBits(bits);
+        payload += bits.bytes;
+    }
+    out.push_back((char)(d >= 0 ? ColumnEncoding::Scaled : ColumnEncoding::Gorilla));
+    putFixed<uint32_t>(out, payload.size());
+    out += payload;
+}
+bool getDoubleColumn(const uint8_t* p, const uint8_t* end, uint8_t encoding, size_t n, double* x) {
+    static const double POW10[10] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+    if (encoding == (uint8_t)ColumnEncoding::Scaled) {
+        uint64_t first;
+        if (p >= end || *p > 9) return false;
+        double scale = POW10[*p++];
+        std::vector<uint64_t> deltas(n - 1);
+        if (!getVarint(p, end, first) || !getPfor(p, end, n - 1, deltas.data())) return false;
+        uint64_t v = unzigzag(first);
+        x[0] = (double)(int64_t)v / scale;
+        for (size_t i = 1; i < n; ++i) {
+            v += unzigzag(deltas[i-1]);
+            x[i] = (double)(int64_t)v / scale;
+        }
+        return true;
+    }
+    if (encoding != (uint8_t)ColumnEncoding::Gorilla || end - p < 16) return false;
+    const size_t limit = (end - p - 8) * 8;  // bits before the padding
+    size_t bit = 0;
+    uint64_t prev = readWideBits(p, bit, 64);
+    memcpy(&x[0], &prev, 8);
+    int lead = 0, len = 0;
+    for (size_t i = 1; i < n; ++i) {
+        if (bit + 1 > limit) return false;
+        if (readWideBits(p, bit, 1)) {
+            if (bit + 1 > limit) return false;
+            if (readWideBits(p, bit, 1)) {
+                if (bit + 11 > limit) return false;
+                lead = readWideBits(p, bit, 5);
+                len = readWideBits(p, bit, 6) + 1;
+            } else if (len == 0) {
+                return false;
+            }
+            if (bit + len > limit || lead + len > 64) return false;
+            prev ^= readWideBits(p, bit, len) << (64 - lead - len);
+        }
+        memcpy(&x[i], &prev, 8);
+    }
+    return true;
+}
+// One block of rows as the bytes described above.
+std::string encodeColumnarBlock(const Candle* rows, size_t n) {
+    std::string out;
+    putFixed<uint32_t>(out, n);
+    std::string payload;
+    putVarint(payload, zigzag(rows[0].timestamp));
+    if (n > 1) putVarint(payload, zigzag(rows[1].timestamp - rows[0].timestamp));
+    std::vector<uint64_t> dods(n > 2 ? n - 2 : 0);
+    for (size_t i = 2; i < n; ++i) dods[i-2] = zigzag((rows[i].timestamp - rows[i-1].timestamp) - (rows[i-1].timestamp - rows[i-2].timestamp));
+    putPfor(payload, dods);
+    out.push_back((char)ColumnEncoding::Timestamp);
+    putFixed<uint32_t>(out, payload.size());
+    out += payload;
+    std::vector<double> column(n);
+    for (double Candle::*field : {&Candle::open, &Candle::high, &Candle::low, &Candle::close}) {
+        for (size_t i = 0; i < n; ++i) column[i] = rows[i].*field;
+        putDoubleColumn(out, column);
+    }
+    payload.clear();
+    for (size_t i = 0; i < n; ++i) putVarint(payload, zigzag(rows[i].volume));
+    out.push_back((char)ColumnEncoding::Varint);
+    putFixed<uint32_t>(out, payload.size());
+    out += payload;
+    for (size_t i = 0; i < n; ++i) column[i] = rows[i].atr;
+    putDoubleColumn(out, column);
+    return out;
+}
+// Decodes the block at [p, end) into chunk.candles and its row statistics, like parseCsvChunk.
+bool decodeColumnarBlock(const uint8_t* p, const uint8_t* end, CsvChunk& chunk, int64_t step) {
+    uint32_t n;
+    if (!getFixed(p, end, n) || n == 0 || n > (1u << 24)) return false;
+    std::vector<int64_t> times(n);
+    std::vector<double> columns[5];
+    std::vector<long long> volumes(n);
+    for (int c = 0; c < 7; ++c) {
+        uint8_t encoding;
+        uint32_t bytes;
+        if (!getFixed(p, end, encoding) || !getFixed(p, end, bytes) || (size_t)(end - p) < bytes) return false;
+        const uint8_t* col = p;
+        const uint8_t* col_end = p + bytes;
+        p = col_end;
+        if (c == 0) {
+            uint64_t first, delta = 0;
+            std::vector<uint64_t> dods(n > 2 ? n - 2 : 0);
+            if (encoding != (uint8_t)ColumnEncoding::Timestamp || !getVarint(col, col_end, first) || (n > 1 && !getVarint(col, col_end, delta))
+                || !getPfor(col, col_end, dods.size(), dods.data())) return false;
+            uint64_t t = unzigzag(first), d = unzigzag(delta);  // unsigned: a corrupt file wraps instead of overflowing
+            times[0] = t;
+            for (size_t i = 1; i < n; ++i) {
+                if (i >= 2) d += unzigzag(dods[i-2]);
+                times[i] = t += d;
+            }
+        } else if (c == 5) {
+            if (encoding != (uint8_t)ColumnEncoding::Varint) return false;
+            for (uint32_t i = 0; i < n; ++i) {
+                uint64_t v;
+                if (!getVarint(col, col_end, v)) return false;
+                volumes[i] = unzigzag(v);
+            }
+        } else {
+            std::vector<double>& x = columns[c < 5 ? c - 1 : 4];
+            x.resize(n);
+            if (!getDoubleColumn(col, col_end, encoding, n, x.data())) return false;
+        }
+    }
+    chunk.candles.resize(n);
+    int64_t last_time = INT64_MIN, day = INT64_MIN;
+    char text[19];
+    for (uint32_t i = 0; i < n; ++i) {
+        Candle& candle = chunk.candles[i];
+        formatTimestamp(times[i], text, day);
+        candle.datetime.assign(text, 19);
+        candle.open = columns[0][i];
+        candle.high = columns[1][i];
+        candle.low = columns[2][i];
+        candle.close = columns[3][i];
+        candle.volume = volumes[i];
+        candle.atr = columns[4][i];
+        candle.timestamp = times[i];
+        chunk.stats.rows++;
+        addRowStats(chunk, candle, last_time, step);
+    }
+    chunk.last_time = last_time;
+    return true;
+}
+// Splits a .scol image into its blocks and decodes them in parallel (serially with threads == 1).
+bool readColumnar(const std::string& data, std::vector<CsvChunk>& chunks, int64_t step, size_t threads) {
+    const uint8_t* base = (const uint8_t*)data.data();
+    const uint8_t* end = base + data.size();
+    const uint8_t* p = base;
+    uint32_t version, block_rows, blocks;
+    uint64_t rows;
+    if (data.compare(0, 4, "SCOL") != 0) return false;
+    p += 4;
+    if (!getFixed(p, end, version) || version != SCOL_VERSION || !getFixed(p, end, rows) || !getFixed(p, end, block_rows)
+        || !getFixed(p, end, blocks) || (size_t)(end - p) / 8 < blocks) return false;
+    std::vector<uint64_t> offsets(blocks + 1);
+    for (uint32_t b = 0; b < blocks; ++b) getFixed(p, end, offsets[b]);
+    offsets[blocks] = data.size();
+    for (uint32_t b = 0; b < blocks; ++b)
+        if (offsets[b] < (uint64_t)(p - base) || offsets[b] > offsets[b+1]) return false;
+    chunks.assign(blocks, CsvChunk());
+    std::atomic<bool> ok{true};
+    auto decode = [&](size_t b) {
+        if (!decodeColumnarBlock(base + offsets[b], base + offsets[b+1], chunks[b], step)) ok = false;
+    };
+    if (threads == 1) for (size_t b = 0; b < blocks; ++b) decode(b);
+    else parallelFor(blocks, decode);
+    size_t decoded = 0;
+    for (const auto& c : chunks) decoded += c.candles.size();
+    return ok && decoded == rows;
+}
+// Writes candles (normally readData's cleaned output) as a .scol archive. Refuses rows the format cannot
+// reproduce exactly: datetimes not in the canonical "YYYY-MM-DD HH:MM:SS" form or before 1970.
+bool writeColumnar(const std::string& path, const std::vector<Candle>& candles) {
+    int64_t day = INT64_MIN;
+    char text[19];
+    for (size_t i = 0; i < candles.size(); ++i) {
+        const Candle& c = candles[i];
+        if (c.timestamp >= 0) formatTimestamp(c.timestamp, text, day);
+        if (c.timestamp < 0 || c.datetime.size() != 19 || c.datetime.compare(0, 19, text, 19) != 0) {
+            std::cerr << path << ": row " << i + 1 << " has datetime '" << c.datetime << "', only YYYY-MM-DD HH:MM:SS from 1970 on can be stored" << std::endl;
+            return false;
+        }
+    }
+    size_t blocks = (candles.size() + SCOL_BLOCK_ROWS - 1) / SCOL_BLOCK_ROWS;
+    std::vector<std::string> encoded(blocks);
+    parallelFor(blocks, [&](size_t b) {
+        size_t begin = b * SCOL_BLOCK_ROWS;
+        encoded[b] = encodeColumnarBlock(&candles[begin], std::min(SCOL_BLOCK_ROWS, candles.size() - begin));
+    });
+    std::string header = "SCOL";
+    putFixed<uint32_t>(header, SCOL_VERSION);
+    putFixed<uint64_t>(header, candles.size());
+    putFixed<uint32_t>(header, SCOL_BLOCK_ROWS);
+    putFixed<uint32_t>(header, blocks);
+    uint64_t offset = header.size() + 8 * blocks;
+    for (const auto& e : encoded) {
+        putFixed<uint64_t>(header, offset);
+        offset += e.size();
+    }
+    std::ofstream f(path, std::ios::binary);
+    f << header;
+    for (const auto& e : encoded) f << e;
+    if (!f) {
+        std::cerr << "Could not write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+// "compress <in.csv> [out.scol]": reads and cleans a CSV like a run would and archives the result.
+int compressCommand(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " compress <in.csv> [out.scol]" << std::endl;
+        return 1;
+    }
+    std::string in = argv[2];
+    std::string out = argc > 3 ? argv[3] : (in.size() > 4 && in.compare(in.size() - 4, 4, ".csv") == 0 ? in.substr(0, in.size() - 4) : in) + ".scol";
+    SeriesStats stats;
+    auto candles = readData(in, &stats);
+    if (candles.empty()) {
+        std::cerr << "No rows in " << in << std::endl;
+        return 1;
+    }
+    if (!writeColumnar(out, candles)) return 1;
+    auto size_of = [](const std::string& file) { std::ifstream f(file, std::ios::binary | std::ios::ate); return f ? (double)f.tellg() : 0.0; };
+    double before = size_of(in), after = size_of(out);
+    std::cout << in << " -> " << out << ": " << candles.size() << "/" << stats.rows << " rows, " << before / 1e6 << " MB -> " << after / 1e6
+              << " MB (" << std::setprecision(3) << (after > 0 ? before / after : 0) << "x)" << std::endl;
+    return 0;
+}
+// --- Shared-memory feed ---
+// A POSIX shm segment (/dev/shm/<name>) through which a fetcher hands bars to this process as fixed-size
+// binary records instead of CSV text. Layout, all little-endian and 64-byte aligned:
+//   FeedHeader        "SIGFEED", version, tickers, capacity (records per ring), record size (64)
+//   per ticker:       FeedRingHeader (name, seq, count) followed by capacity FeedRecords
+// Record i of a ticker lives in slot i % capacity; count is the number of records ever appended, so a
+// ring holds records [count - capacity, count). There is one writer per segment. It appends a bar, or
+// rewrites the newest record in place when the bar has the same timestamp (the bar still forming), and
+// ignores bars older than the newest. Each write is wrapped in the ring's seqlock: seq is odd while a
+// write is in progress and is bumped again when it is done. Readers copy records straight from the mapping
+// and retry if seq was odd or changed meanwhile, so the writer never waits for a reader.
+// This relies on x86-64 ordering (aligned 8-byte stores are atomic and stores are not reordered), which
+// is also what lets the Python writer (shm_feed.py) take part.
+const uint32_t FEED_VERSION = 1;
+const uint32_t FEED_CAPACITY = 16384;
+bool createFeed(FeedSegment& seg, const std::string& name, const std::vector<std::string>& tickers, uint32_t capacity) {
+    seg.name = name;
+    seg.tickers = tickers.size();
+    seg.capacity = capacity;
+    seg.bytes = sizeof(FeedHeader) + tickers.size() * (sizeof(FeedRingHeader) + (size_t)capacity * sizeof(FeedRecord));
+    int fd = shm_open(("/" + name).c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, seg.bytes) != 0) {
+        std::cerr << "Could not create shared memory " << name << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, seg.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "Could not map shared memory " << name << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    seg.base = (uint8_t*)base;
+    // The new file is zero-filled, so every ring starts with seq = count = 0.
+    for (size_t k = 0; k < tickers.size(); ++k)
+        strncpy(feedRing(seg, k)->ticker, tickers[k].c_str(), sizeof(FeedRingHeader::ticker) - 1);
+    FeedHeader* header = (FeedHeader*)seg.base;
+    header->version = FEED_VERSION;
+    header->tickers = seg.tickers;
+    header->capacity = capacity;
+    header->record_size = sizeof(FeedRecord);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, "SIGFEED", 8);  // last, so a reader never sees a half-built segment as valid
+    return true;
+}
+bool openFeed(FeedSegment& seg, const std::string& name, bool writable) {
+    seg.name = name;
+    int fd = shm_open(("/" + name).c_str(), writable ? O_RDWR : O_RDONLY, 0);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FeedHeader)) {
+        std::cerr << "No shared memory feed " << name << (fd < 0 ? std::string(": ") + strerror(errno) : "") << std::endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, st.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return false;
+    seg.base = (uint8_t*)base;
+    seg.bytes = st.st_size;
+    const FeedHeader* header = (const FeedHeader*)seg.base;
+    seg.tickers = header->tickers;
+    seg.capacity = header->capacity;
+    if (memcmp(header->magic, "SIGFEED", 8) != 0 || header->version != FEED_VERSION || header->record_size != sizeof(FeedRecord)
+        || seg.capacity == 0 || seg.bytes < sizeof(FeedHeader) + seg.tickers * (sizeof(FeedRingHeader) + (size_t)seg.capacity * sizeof(FeedRecord))) {
+        std::cerr << "Shared memory " << name << " is not a version " << FEED_VERSION << " feed" << std::endl;
+        closeFeed(seg);
+        return false;
+    }
+    return true;
+}
+void closeFeed(FeedSegment& seg) {
+    if (seg.base) munmap(seg.base, seg.bytes);
+    seg.base = nullptr;
+}
+FeedRingHeader* feedRing(const FeedSegment& seg, size_t ring) {
+    return (FeedRingHeader*)(seg.base + sizeof(FeedHeader) + ring * (sizeof(FeedRingHeader) + (size_t)seg.capacity * sizeof(FeedRecord)));
+}
+FeedRecord* feedRecords(const FeedSegment& seg, size_t ring) {
+    return (FeedRecord*)(feedRing(seg, ring) + 1);
+}
+int feedRingIndex(const FeedSegment& seg, const std::string& ticker) {
+    for (size_t k = 0; k < seg.tickers; ++k)
+        if (strncmp(feedRing(seg, k)->ticker, ticker.c_str(), sizeof(FeedRingHeader::ticker)) == 0) return k;
+    return -1;
+}
+// Writer side: append rec, or overwrite the newest record if it has the same timestamp. Returns false
+// (and writes nothing) for a bar older than the newest.
+bool feedPublish(FeedSegment& seg, size_t ring, const FeedRecord& rec) {
+    FeedRingHeader* h = feedRing(seg, ring);
+    FeedRecord* records = feedRecords(seg, ring);
+    uint64_t count = h->count.load(std::memory_order_relaxed);
+    int64_t newest = count > 0 ? records[(count - 1) % seg.capacity].timestamp : INT64_MIN;
+    if (rec.timestamp < newest) return false;
+    uint64_t slot = rec.timestamp == newest ? count - 1 : count;
+    uint64_t seq = h->seq.load(std::memory_order_relaxed);
+    h->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    records[slot % seg.capacity] = rec;
+    h->count.store(slot + 1, std::memory_order_relaxed);
+    h->seq.store(seq + 2, std::memory_order_release);
+    return true;
+}
+// Reader side: copies up to max_records records starting at index from (or at the oldest one still in
+// the ring, if from has been overwritten) into out, under the seqlock. first is the index of out[0];
+// returns the ring's count at the time of the copy.
+uint64_t feedRead(const FeedSegment& seg, size_t ring, uint64_t from, size_t max_records, std::vector<FeedRecord>& out, uint64_t& first) {
+    const FeedRingHeader* h = feedRing(seg, ring);
+    const FeedRecord* records = feedRecords(seg, ring);
+    while (true) {
+        uint64_t seq = h->seq.load(std::memory_order_acquire);
+        if (seq & 1) { std::this_thread::yield(); continue; }
+        uint64_t count = h->count.load(std::memory_order_relaxed);
+        first = std::max(from, count > seg.capacity ? count - seg.capacity : 0);
+        uint64_t end = std::min<uint64_t>(count, first + max_records);
+        out.resize(end > first ? end - first : 0);
+        for (uint64_t i = first; i < end; ++i) out[i - first] = records[i % seg.capacity];
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (h->seq.load(std::memory_order_relaxed) == seq) return count;
+    }
+}
+// Records ever appended for a ticker, capped at what the ring holds (0 if there is no such feed or ticker).
+size_t feedRows(const std::string& name, const std::string& ticker) {
+    FeedSegment seg;
+    if (!openFeed(seg, name)) return 0;
+    int k = feedRingIndex(seg, ticker);
+    size_t rows = k < 0 ? 0 : std::min<uint64_t>(feedRing(seg, k)->count.load(std::memory_order_acquire), seg.capacity);
+    closeFeed(seg);
+    return rows;
+}
+// The ticker's bars currently in the feed, oldest first, with the same statistics readData gathers.
+// Copied in batches so a busy writer rarely forces a retry; bars the writer overwrote before they were
+// read are counted as rejected. *next is set to the feed index following the last bar returned.
+std::vector<Candle> readFeed(const std::string& name, const std::string& ticker, SeriesStats* stats, uint64_t* next) {
+    SeriesStats local;
+    SeriesStats& st = stats ? *stats : local;
+    std::vector<Candle> candles;
+    FeedSegment seg;
+    if (!openFeed(seg, name)) return candles;
+    int k = feedRingIndex(seg, ticker);
+    if (k < 0) {
+        std::cerr << "No " << ticker << " in shared memory feed " << name << std::endl;
+        closeFeed(seg);
+        return candles;
+    }
+    CsvChunk chunk;
+    std::vector<FeedRecord> batch;
+    uint64_t cursor = 0, first = 0, target = 0;
+    int64_t last_time = INT64_MIN, day = INT64_MIN;
+    char text[19];
+    do {
+        uint64_t count = feedRead(seg, k, cursor, 4096, batch, first);
+        if (cursor == 0) {
+            target = count;  // stop at what was there when we started
+            cursor = first;
+        }
+        if (first > cursor) chunk.stats.rejected["overwritten before read"] += first - cursor;
+        for (const FeedRecord& r : batch) {
+            if (first++ >= target) break;
+            Candle c;
+            formatTimestamp(r.timestamp, text, day);
+            c.datetime.assign(text, 19);
+            c.open = r.open; c.high = r.high; c.low = r.low; c.close = r.close; c.volume = r.volume; c.atr = r.atr; c.timestamp = r.timestamp;
+            chunk.stats.rows++;
+            addRowStats(chunk, c, last_time, st.step);
+            chunk.candles.push_back(std::move(c));
+        }
+        cursor = first;
+    } while (cursor < target && !batch.empty());
+    closeFeed(seg);
+    if (next) *next = std::min(cursor, target);
+    chunk.last_time = last_time;
+    int64_t merged_time = INT64_MIN;
+    bool repeated = false;
+    mergeChunkStats(st, chunk, merged_time, repeated);
+    candles = std::move(chunk.candles);
+    if (!candles.empty()) {
+        st.first_time = candles.front().timestamp;
+        st.last_time = candles.back().timestamp;
+    }
+    return candles;
+}
+// "replay <config_file> [--shm=NAME] [--capacity=N] [--history=N] [--speed=X|max]": a local producer, so
+// the live path can be tested and timed without a network. Creates the feed for the config's tickers and
+// publishes the first --history bars of each data file at once (default: all of them). If bars remain,
+// it waits for a `--live` reader to attach, then publishes the rest as one time-ordered stream across
+// all tickers, X times faster than the bars' own timestamps (1 = real time) or as fast as it can, and
+// finally marks the feed closed so the reader prints its latency report and exits.
+int replayCommand(int argc, char* argv[]) {
+    std::string name = "signal_feed";
+    uint32_t capacity = FEED_CAPACITY;
+    size_t history = SIZE_MAX;
+    double speed = 0;  // 0 = as fast as possible
+    bool ok = argc >= 3;
+    for (int i = 3; ok && i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq);
+        std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
         try {
-            candles.push_back({dt, std::stod(o), std::stod(h), std::stod(l), std::stod(c), std::stoll(v), std::stod(atr_str)});
-        } catch (const std::exception& e) {}
+            if (key == "--shm" && !value.empty()) name = value;
+            else if (key == "--capacity") capacity = std::stoul(value);
+            else if (key == "--history") history = std::stoul(value);
+            else if (key == "--speed") { speed = value == "max" ? 0 : std::stod(value); ok = value == "max" || speed > 0; }
+            else ok = false;
+        } catch (const std::exception& e) { ok = false; }
+    }
+    std::vector<PairConfig> cfgs;
+    if (!ok || capacity == 0 || !readConfig(argv[2], cfgs)) {
+        std::cerr << "Usage: " << argv[0] << " replay <config_file> [--shm=NAME] [--capacity=N] [--history=N] [--speed=X|max]" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> tickers;
+    std::vector<std::vector<Candle>> series(cfgs.size());
+    std::vector<std::vector<int64_t>> times(cfgs.size());  // of the bars after the history
+    std::vector<const std::vector<int64_t>*> columns;
+    for (size_t k = 0; k < cfgs.size(); ++k) {
+        tickers.push_back(cfgs[k].ticker);
+        series[k] = readData(tickerDataFile(cfgs[k].ticker));
+        for (size_t i = std::min(history, series[k].size()); i < series[k].size(); ++i) times[k].push_back(series[k][i].timestamp);
+        columns.push_back(&times[k]);
+    }
+    FeedSegment seg;
+    if (!createFeed(seg, name, tickers, capacity)) return 1;
+    FeedHeader* header = (FeedHeader*)seg.base;
+    size_t published = 0, refused = 0, preloaded = 0;
+    auto publish = [&](size_t k, const Candle& c) {
+        FeedRecord rec{c.timestamp, c.open, c.high, c.low, c.close, c.volume, c.atr, 0};
+        rec.published_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (feedPublish(seg, k, rec)) published++;
+        else refused++;
+    };
+    for (size_t k = 0; k < cfgs.size(); ++k)
+        for (size_t i = 0; i < series[k].size() - times[k].size(); ++i) publish(k, series[k][i]);
+    preloaded = published;
+
+    size_t remaining = 0;
+    int64_t t0 = INT64_MAX;
+    for (const auto& t : times) {
+        remaining += t.size();
+        if (!t.empty()) t0 = std::min(t0, t.front());
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (remaining > 0) {
+        std::cout << "Preloaded " << preloaded << " bars into /dev/shm/" << name << "; waiting for a reader (" << argv[0] << " "
+                  << argv[2] << " --shm=" << name << " --live) to replay " << remaining << " more" << std::endl;
+        while (header->followers.load() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        start = std::chrono::steady_clock::now();
+        mergeTimeline(columns, true, [&](const std::vector<size_t>& cursor, const std::vector<char>& present) {
+            size_t first = std::find(present.begin(), present.end(), 1) - present.begin();
+            if (speed > 0) {
+                int64_t due = times[first][cursor[first]] - t0;  // seconds of market time since the first replayed bar
+                std::this_thread::sleep_until(start + std::chrono::duration<double>(due / speed));
+            }
+            for (size_t k = 0; k < cfgs.size(); ++k)
+                if (present[k]) publish(k, series[k][series[k].size() - times[k].size() + cursor[k]]);
+        });
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    header->closed.store(1, std::memory_order_release);
+    closeFeed(seg);
+    std::cout << "Replayed " << published << " bars of " << cfgs.size() << " tickers into /dev/shm/" << name;
+    if (remaining > 0) {
+        std::cout << ", " << published - preloaded << " of them ";
+        if (speed > 0) std::cout << "at " << speed << "x";
+        else std::cout << "as fast as possible";
+        std::cout << " in " << secs << "s (" << (secs > 0 ? (published - preloaded) / secs : 0.0) << " bars/s)";
+    }
+    if (refused) std::cout << " (" << refused << " older than the newest bar, skipped)";
+    std::cout << std::endl;
+    return 0;
+}
+// Latency histogram with log-linear buckets: 16 linear steps per power of two, so any percentile is
+// within 1/16 (about 6%) of the true value, in a fixed array and whatever the range.
+void latencyRecord(LatencyHistogram& h, int64_t ns) {
+    uint64_t v = ns > 0 ? ns : 0;
+    int top = v < 16 ? 0 : 63 - __builtin_clzll(v) - 4;  // v >> top lands in 16..31 (or v < 16 as is)
+    size_t bucket = v < 16 ? v : 16 * top + (v >> top);
+    h.counts[std::min(bucket, h.counts.size() - 1)]++;
+    h.total++;
+    h.max_ns = std::max(h.max_ns, ns);
+}
+int64_t latencyPercentile(const LatencyHistogram& h, double p) {
+    uint64_t rank = (uint64_t)std::ceil(p / 100.0 * h.total), seen = 0;
+    for (size_t b = 0; b < h.counts.size(); ++b) {
+        seen += h.counts[b];
+        if (seen >= std::max<uint64_t>(rank, 1)) {
+            if (b < 16) return b;
+            int top = b / 16 - 1;
+            return std::min<int64_t>((int64_t)((b % 16 + 16) << top) + ((1ll << top) >> 1), h.max_ns);  // bucket midpoint
+        }
+    }
+    return h.max_ns;
+}
+// The live path: after the one-shot pass, follows the shared-memory feed and re-evaluates each ticker's
+// optimised strategy on every bar that arrives (or is rewritten in place), printing tradable signals.
+// Each bar's latency is the steady-clock time from the producer publishing it to its signal being known;
+// the per-ticker histograms are printed when the producer closes the feed (replay does) or on Ctrl-C.
+// Bars the producer overwrote before they were read (it lapped us) are counted as lost.
+void followFeed(std::vector<TickerRun>& runs, const std::vector<RunOptions>& ticker_opts, const RunOptions& opts) {
+    FeedSegment seg;
+    if (!openFeed(seg, opts.shm, true)) return;
+    std::vector<LiveTicker> live;
+    for (size_t k = 0; k < runs.size(); ++k) {
+        int ring = runs[k].ok ? feedRingIndex(seg, runs[k].ticker) : -1;
+        if (ring < 0) continue;
+        LiveTicker t;
+        t.run = k;
+        t.ring = ring;
+        t.cursor = runs[k].feed_cursor;
+        t.keep = std::max<size_t>(runs[k].cache.closes.size(), 1000);
+        t.direction = runs[k].signal == "BUY" ? 1 : runs[k].signal == "SELL" ? -1 : 0;
+        t.programs = compileLiveRules(opts.rules, runs[k].params, runs[k].cache.has_volume);
+        runs[k].cache.risk_lots.clear();  // not kept up to date here; lots come from the risk budget directly
+        if (t.cursor > 0) {
+            std::vector<FeedRecord> newest;
+            uint64_t first;
+            feedRead(seg, ring, t.cursor - 1, 1, newest, first);
+            if (!newest.empty() && first == t.cursor - 1) t.last = newest[0];
+        }
+        live.push_back(t);
+    }
+    // The correlation filter keeps running here: every aligned step every followed ticker has reached is
+    // pushed once, starting from the same window the one-shot filter used.
+    std::vector<size_t> members;
+    std::vector<const std::vector<int64_t>*> columns;
+    for (const LiveTicker& t : live) {
+        members.push_back(t.run);
+        columns.push_back(&runs[t.run].cache.timestamps);
+    }
+    RollingCorrelation rc = makeRollingCorrelation(members.size(), opts.corr_window);
+    int64_t corr_time = INT64_MIN;
+    if (opts.corr_filter > 0) corr_time = pushAlignedReturns(rc, runs, members, timelineTailStart(columns, opts.corr_window + 1), INT64_MAX);
+
+    static volatile std::sig_atomic_t interrupted;
+    interrupted = 0;
+    auto previous = std::signal(SIGINT, [](int) { interrupted = 1; });
+    FeedHeader* header = (FeedHeader*)seg.base;
+    header->followers.fetch_add(1);
+    std::cout << "\nFollowing /dev/shm/" << opts.shm << " for " << live.size() << " tickers (Ctrl-C to stop)" << std::endl;
+
+    std::vector<FeedRecord> batch;
+    std::vector<Candle> bar(1);
+    char text[19];
+    size_t idle = 0, bars = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (!interrupted) {
+        bool closed = header->closed.load(std::memory_order_acquire) != 0, any = false;
+        for (LiveTicker& t : live) {
+            TickerRun& run = runs[t.run];
+            const RunOptions& topts = ticker_opts[t.run];
+            uint64_t first;
+            // Re-read the newest bar already seen too, in case it was rewritten since.
+            feedRead(seg, t.ring, t.cursor > 0 ? t.cursor - 1 : 0, 4096, batch, first);
+            if (first > t.cursor) t.lost += first - t.cursor;
+            for (size_t j = 0; j < batch.size(); ++j) {
+                const FeedRecord& r = batch[j];
+                uint64_t index = first + j;
+                bool rewrite = index + 1 == t.cursor;
+                if (rewrite && memcmp(&r, &t.last, sizeof(r)) == 0) continue;
+                if (rewrite) popSeriesCache(run.cache);
+                int64_t day = INT64_MIN;
+                formatTimestamp(r.timestamp, text, day);
+                Candle& c = bar[0];
+                c.datetime.assign(text, 19);
+                c.open = r.open; c.high = r.high; c.low = r.low; c.close = r.close; c.volume = r.volume; c.atr = r.atr; c.timestamp = r.timestamp;
+                appendSeriesCache(run.cache, bar);
+                size_t i = run.cache.closes.size() - 1;
+                if (t.programs.has_volume != run.cache.has_volume) t.programs = compileLiveRules(opts.rules, run.params, run.cache.has_volume);
+                std::string signal = liveSignal(run.cache, run.params, t.programs, i);
+                bool tradable = signal != "HOLD" && run.cache.atr_percent[i] > (float)run.params.min_atr_percent;
+                t.direction = tradable ? (signal == "BUY" ? 1 : -1) : 0;
+                for (size_t u = 0; tradable && opts.corr_filter > 0 && u < live.size(); ++u) {
+                    const LiveTicker& other = live[u];
+                    if (&other == &t || other.direction == 0) continue;
+                    double rho = correlationOf(rc, &t - live.data(), u);
+                    if (std::fabs(rho) >= opts.corr_filter && rho * t.direction * other.direction > 0) {
+                        std::cout << "Correlation filter: dropped LIVE " << run.ticker << " " << signal << ", rho=" << rho << " with "
+                                  << runs[other.run].ticker << " " << (other.direction > 0 ? "BUY" : "SELL") << " over the last " << rc.count << " bars\n";
+                        tradable = false;
+                        t.direction = 0;
+                    }
+                }
+                latencyRecord(t.latency, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count() - r.published_ns);
+                if (tradable) {
+                    double sl = signal == "BUY" ? r.close - run.params.sl_atr * r.atr : r.close + run.params.sl_atr * r.atr;
+                    double tp = signal == "BUY" ? r.close + run.params.tp_atr * r.atr : r.close - run.params.tp_atr * r.atr;
+                    std::cout << "LIVE " << c.datetime << " | " << run.ticker << " | " << signal << " | Entry=" << r.close << " SL=" << sl << " TP=" << tp;
+                    double risk_cash = topts.account * topts.risk_percent / 100.0;
+                    if (risk_cash > 0 && topts.instrument.pip_value > 0)
+                        std::cout << " Lots=" << roundLots(risk_cash / (std::fabs(r.close - sl) * topts.instrument.pip_value), topts.instrument.lot_step);
+                    std::cout << (rewrite ? " (bar updated)\n" : "\n");
+                }
+                t.last = r;
+                t.cursor = index + 1;
+                t.bars++;
+                bars++;
+                any = true;
+            }
+            if (run.cache.closes.size() > 2 * t.keep) trimSeriesCache(run.cache, t.keep);
+        }
+        if (any && opts.corr_filter > 0) {
+            // A step is complete once every followed ticker has a bar at or after it.
+            int64_t reached = INT64_MAX;
+            for (const LiveTicker& t : live) reached = std::min(reached, runs[t.run].cache.timestamps.empty() ? INT64_MIN : runs[t.run].cache.timestamps.back());
+            if (reached > corr_time) corr_time = pushAlignedReturns(rc, runs, members, corr_time, reached);
+        }
+        if (any) { idle = 0; continue; }
+        if (closed) break;
+        // Yield first (on a busy box the producer may need this core), then back off to short sleeps.
+        if (++idle < 1000) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    header->followers.fetch_sub(1);
+    std::signal(SIGINT, previous);
+    closeFeed(seg);
+    std::cout << std::flush << "\nLive: " << bars << " bars in " << secs << "s (" << (secs > 0 ? bars / secs : 0.0) << " bars/s)"
+              << (interrupted ? ", interrupted" : ", feed closed by the producer") << std::endl;
+    for (const LiveTicker& t : live) {
+        const LatencyHistogram& h = t.latency;
+        std::cout << "Latency " << runs[t.run].ticker << ": " << t.bars << " bars";
+        if (h.total) std::cout << ", bar-to-signal p50=" << latencyPercentile(h, 50) / 1e3 << "us p99=" << latencyPercentile(h, 99) / 1e3 << "us max=" << h.max_ns / 1e3 << "us";
+        if (t.lost) std::cout << ", " << t.lost << " lost (overwritten before read)";
+        std::cout << std::endl;
+    }
+}
+// --- Tick aggregation ---
+// Builds OHLCV bars of several intervals at once from (time, price, size) ticks. Each tick costs one
+// compare, a min, a max and an add per interval and never allocates; only a closing bar touches the
+// output columns (amortised growth). Bars start on multiples of the interval since the epoch and an
+// interval without ticks gets no bar. A closing bar's ATR is the mean true range of the last 14 bars,
+// as the fetcher computes it, and bars before the 14th (no ATR yet) are left out, as the fetcher's
+// dropna does. Ticks older than the bar being built are late and are dropped.
+const size_t TICK_ATR_PERIOD = 14;
+TickAggregator makeTickAggregator(const std::vector<int64_t>& periods) {
+    TickAggregator agg;
+    for (int64_t p : periods) {
+        BarFrame f;
+        f.period_ms = p * 1000;
+        agg.frames.push_back(f);
+    }
+    return agg;
+}
+void aggregateTick(TickAggregator& agg, int64_t time_ms, double price, long long size) {
+    agg.ticks++;
+    bool late = false;
+    for (BarFrame& f : agg.frames) {
+        if (time_ms >= f.end) {
+            if (f.forming) closeBar(f);
+            f.start = time_ms - ((time_ms % f.period_ms) + f.period_ms) % f.period_ms;
+            f.end = f.start + f.period_ms;
+            f.open = f.high = f.low = price;
+            f.volume = 0;
+            f.forming = true;
+        } else if (time_ms < f.start) {
+            late = true;
+            continue;
+        }
+        f.high = std::max(f.high, price);
+        f.low = std::min(f.low, price);
+        f.close = price;
+        f.volume += size;
+    }
+    agg.late += late;
+}
+void closeBar(BarFrame& f) {
+    double range = f.high - f.low;
+    f.tr[f.bars % TICK_ATR_PERIOD] = std::isnan(f.prev_close) ? range : std::max({range, std::fabs(f.high - f.prev_close), std::fabs(f.low - f.prev_close)});
+    f.bars++;
+    f.prev_close = f.close;
+    f.forming = false;
+    if (f.bars < TICK_ATR_PERIOD) return;
+    double sum = 0;
+    for (double tr : f.tr) sum += tr;
+    CandleColumns& out = f.out;
+    out.timestamp.push_back(f.start / 1000);
+    out.open.push_back(f.open);
+    out.high.push_back(f.high);
+    out.low.push_back(f.low);
+    out.close.push_back(f.close);
+    out.volume.push_back(f.volume);
+    out.atr.push_back(sum / TICK_ATR_PERIOD);
+}
+// Closes the bars still being built (end of input).
+void flushTicks(TickAggregator& agg) {
+    for (BarFrame& f : agg.frames)
+        if (f.forming) closeBar(f);
+}
+std::vector<Candle> columnsToCandles(const CandleColumns& c) {
+    std::vector<Candle> candles(c.timestamp.size());
+    int64_t day = INT64_MIN;
+    char text[19];
+    for (size_t i = 0; i < candles.size(); ++i) {
+        formatTimestamp(c.timestamp[i], text, day);
+        candles[i] = {std::string(text, 19), c.open[i], c.high[i], c.low[i], c.close[i], c.volume[i], c.atr[i], c.timestamp[i]};
     }
     return candles;
 }
-bool hasVolumeData(const std::vector<Candle>& candles) {
-    long long total_volume = 0;
-    for(const auto& c : candles) total_volume += c.volume;
-    return total_volume > 0;
+// "aggregate <ticks.csv> [--intervals=5m,15m,1h,...] [--alias]": rows of Ticker,Time,Price,Size (Time in
+// epoch milliseconds, one header line, tickers interleaved in time order) become <TICKER>_<interval>.scol
+// for every interval. --alias also writes the first interval as <TICKER>.scol, which runs then prefer to
+// the fetcher's CSV for as long as it is the newer of the two (tickerDataFile).
+int aggregateCommand(int argc, char* argv[]) {
+    std::vector<std::string> intervals;
+    bool ok = argc >= 3, alias = false;
+    for (int i = 3; ok && i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--alias") { alias = true; continue; }
+        if (arg.rfind("--intervals=", 0) != 0) { ok = false; break; }
+        std::stringstream list(arg.substr(12));
+        for (std::string item; getline(list, item, ',');) intervals.push_back(item);
+    }
+    if (intervals.empty()) intervals = {"5m", "15m", "1h", "4h"};
+    std::vector<int64_t> periods;
+    for (const auto& name : intervals) {
+        periods.push_back(parseInterval(name));
+        ok = ok && periods.back() > 0;
+    }
+    std::ifstream f(ok ? argv[2] : "", std::ios::binary | std::ios::ate);
+    if (!ok || !f) {
+        std::cerr << "Usage: " << argv[0] << " aggregate <ticks.csv> [--intervals=5m,15m,1h,4h] [--alias]  (rows: Ticker,Time(ms),Price,Size)" << std::endl;
+        return 1;
+    }
+    std::string text((size_t)f.tellg(), '\0');
+    f.seekg(0);
+    f.read(&text[0], text.size());
+
+    std::vector<std::pair<std::string, TickAggregator>> tickers;
+    size_t current = 0, rejected = 0;
+    auto start = std::chrono::steady_clock::now();
+    const char* end = text.data() + text.size();
+    const char* p = (const char*)memchr(text.data(), '\n', text.size());  // Skip header
+    for (p = p ? p + 1 : end; p < end; ) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol) eol = end;
+        const char* field[4];
+        size_t len[4];
+        const char* q = p;
+        for (int k = 0; k < 4; ++k) {
+            const char* comma = q < eol ? (const char*)memchr(q, ',', eol - q) : nullptr;
+            const char* stop = comma ? comma : eol;
+            field[k] = q;
+            len[k] = stop - q;
+            q = comma ? comma + 1 : eol;
+        }
+        p = eol + 1;
+        if (len[3] > 0 && field[3][len[3] - 1] == '\r') len[3]--;
+        long long time_ms, size;
+        double price;
+        if (len[0] == 0 || !csvNumber(field[1], len[1], time_ms) || !csvNumber(field[2], len[2], price) || !csvNumber(field[3], len[3], size)) {
+            rejected++;
+            continue;
+        }
+        // Ticks of one ticker tend to come in runs, so check the previous one first.
+        if (current >= tickers.size() || tickers[current].first.compare(0, std::string::npos, field[0], len[0]) != 0) {
+            current = 0;
+            while (current < tickers.size() && tickers[current].first.compare(0, std::string::npos, field[0], len[0]) != 0) current++;
+            if (current == tickers.size()) tickers.emplace_back(std::string(field[0], len[0]), makeTickAggregator(periods));
+        }
+        aggregateTick(tickers[current].second, time_ms, price, size);
+    }
+    size_t ticks = 0, late = 0;
+    for (auto& t : tickers) {
+        flushTicks(t.second);
+        ticks += t.second.ticks;
+        late += t.second.late;
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Aggregated " << ticks << " ticks of " << tickers.size() << " tickers in " << secs << "s (" << (secs > 0 ? ticks / secs / 1e6 : 0.0)
+              << "M ticks/s incl. parsing)";
+    if (late) std::cout << ", " << late << " late ticks dropped";
+    if (rejected) std::cout << ", " << rejected << " unparseable rows";
+    std::cout << std::endl;
+    for (auto& t : tickers) {
+        std::cout << "  " << t.first << ":";
+        for (size_t k = 0; k < intervals.size(); ++k) {
+            std::vector<Candle> candles = columnsToCandles(t.second.frames[k].out);
+            std::cout << " " << intervals[k] << " x" << candles.size();
+            if (!writeColumnar(t.first + "_" + intervals[k] + ".scol", candles)) return 1;
+            if (k == 0 && alias && !writeColumnar(t.first + ".scol", candles)) return 1;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+// "5m", "1h", "4h", "1d" to seconds; 0 if it is not one of those shapes.
+int64_t parseInterval(const std::string& interval) {
+    if (interval.size() < 2) return 0;
+    int64_t count = std::atoll(interval.substr(0, interval.size() - 1).c_str());
+    switch (interval.back()) {
+        case 'm': return count * 60;
+        case 'h': return count * 3600;
+        case 'd': return count * 86400;
+    }
+    return 0;
+}
+// Folds every base bar not yet seen into all frames in a single pass. Each frame buckets by its period
+// (aligned to the epoch) and keeps a 14-bar ATR of the resampled bars; the last bar stays open and is
+// updated in place, so calling this again after new candles arrive only touches the new ones.
+void resampleAppend(std::vector<ResampledSeries>& frames, const std::vector<Candle>& candles) {
+    const int ATR_PERIOD = 14;
+    for (auto& f : frames) {
+        if (f.tr_sum.empty()) f.tr_sum.push_back(0.0);
+        for (size_t i = f.bucket_of.size(); i < candles.size(); ++i) {
+            const Candle& c = candles[i];
+            int64_t bucket = c.timestamp - ((c.timestamp % f.period) + f.period) % f.period;
+            if (f.start.empty() || bucket > f.start.back()) {
+                f.start.push_back(bucket);
+                f.open.push_back(c.open);
+                f.high.push_back(c.high);
+                f.low.push_back(c.low);
+                f.close.push_back(c.close);
+                f.volume.push_back(c.volume);
+                f.tr_sum.push_back(0.0);
+                f.atr.push_back(0.0);
+            } else {
+                f.high.back() = std::max(f.high.back(), c.high);
+                f.low.back() = std::min(f.low.back(), c.low);
+                f.close.back() = c.close;
+                f.volume.back() += c.volume;
+            }
+            size_t k = f.start.size() - 1;
+            double tr = f.high[k] - f.low[k];
+            if (k > 0) tr = std::max({tr, std::fabs(f.high[k] - f.close[k-1]), std::fabs(f.low[k] - f.close[k-1])});
+            f.tr_sum[k+1] = f.tr_sum[k] + tr;
+            size_t span = std::min<size_t>(k + 1, ATR_PERIOD);
+            f.atr[k] = (f.tr_sum[k+1] - f.tr_sum[k+1-span]) / span;
+            f.bucket_of.push_back((uint32_t)k);
+        }
+    }
+}
+// Per base bar: sign of (close - SMA) of the last *closed* resampled bar, so the backtest never sees a
+// higher-timeframe bar before it has finished.
+std::vector<int8_t> htfTrend(const ResampledSeries& frame, int sma_period) {
+    std::vector<double> sums(frame.close.size() + 1, 0.0);
+    for (size_t k = 0; k < frame.close.size(); ++k) sums[k+1] = sums[k] + frame.close[k];
+    std::vector<int8_t> trend(frame.bucket_of.size(), 0);
+    for (size_t i = 0; i < trend.size(); ++i) {
+        size_t b = frame.bucket_of[i];
+        if (b < (size_t)sma_period) continue;
+        double sma = (sums[b] - sums[b - sma_period]) / sma_period;
+        trend[i] = (frame.close[b-1] > sma) - (frame.close[b-1] < sma);
+    }
+    return trend;
 }
-void logTrade(const std::string& datetime, const std::string& ticker, const std::string& signal, double entry, double sl, double tp) {
+// New logs get a Lots column (0 = unsized); a log started before it existed keeps its six columns.
+void logTrade(const std::string& datetime, const std::string& ticker, const std::string& signal, double entry, double sl, double tp, double lots) {
+    std::string header;
+    {
+        std::ifstream existing("tradelog.csv");
+        getline(existing, header);
+    }
+    bool with_lots = header.empty() || header.find(",Lots") != std::string::npos;
     std::ofstream logfile("tradelog.csv", std::ios::app);
-    if (logfile.tellp() == 0) logfile << "Datetime,Ticker,Signal,Entry,StopLoss,TakeProfit\n";
-    logfile << datetime << "," << ticker << "," << signal << "," << std::fixed << std::setprecision(5) << entry << "," << sl << "," << tp << "\n";
+    if (logfile.tellp() == 0) logfile << "Datetime,Ticker,Signal,Entry,StopLoss,TakeProfit,Lots\n";
+    logfile << datetime << "," << ticker << "," << signal << "," << std::fixed << std::setprecision(5) << entry << "," << sl << "," << tp;
+    if (with_lots) logfile << "," << std::setprecision(2) << lots;
+    logfile << "\n";
 }
 double computeSMA(const std::vector<double>& prices, size_t end_index, int period) {
     if (end_index + 1 < period || period <= 0) return 0;
@@ -224,20 +2885,738 @@ int computeOBVDirection(const std::vector<Candle>& candles, int period) {
     if (history.back() < history.front()) return -1;
     return 0;
 }
+SeriesCache buildSeriesCache(const std::vector<Candle>& candles) {
+    SeriesCache cache;
+    appendSeriesCache(cache, candles);
+    return cache;
+}
+// Extends every column by the given bars, continuing the prefix sums and OBV from the cache's last bar,
+// so building a cache in pieces gives the same numbers as building it in one go.
+void appendSeriesCache(SeriesCache& cache, const std::vector<Candle>& candles) {
+    size_t old = cache.closes.size(), n = old + candles.size();
+    if (cache.close_sum.empty()) {
+        cache.close_sum.push_back(0.0);
+        cache.gain_sum.push_back(0.0);
+        cache.loss_sum.push_back(0.0);
+        cache.centered_sq_sum.push_back(0.0);
+    }
+    if (old == 0) cache.center = candles.empty() ? 0.0 : candles[0].close;
+    cache.closes.resize(n);
+    cache.highs.resize(n);
+    cache.lows.resize(n);
+    cache.atr.resize(n);
+    cache.atr_percent.resize(n);
+    cache.obv.resize(n, 0);
+    cache.close_sum.resize(n + 1, 0.0);
+    cache.gain_sum.resize(n + 1, 0.0);
+    cache.loss_sum.resize(n + 1, 0.0);
+    cache.centered_sq_sum.resize(n + 1, 0.0);
+    long long total_volume = 0;
+    for (size_t i = old; i < n; ++i) {
+        const Candle& c = candles[i - old];
+        cache.closes[i] = c.close;
+        cache.highs[i] = c.high;
+        cache.lows[i] = c.low;
+        cache.atr[i] = c.atr;
+        // Truncated to 3 decimals in float, exactly as the live volatility gate has always done it.
+        float atr_percent = (int)((c.atr / c.close) * 100*1000);
+        cache.atr_percent[i] = atr_percent/1000;
+        double change = (i > 0) ? c.close - cache.closes[i-1] : 0.0;
+        cache.close_sum[i+1] = cache.close_sum[i] + c.close;
+        cache.gain_sum[i+1] = cache.gain_sum[i] + (change > 0 ? change : 0.0);
+        cache.loss_sum[i+1] = cache.loss_sum[i] + (change < 0 ? -change : 0.0);
+        cache.centered_sq_sum[i+1] = cache.centered_sq_sum[i] + (c.close - cache.center) * (c.close - cache.center);
+        // Cumulative OBV: the direction over any period is the sign of a difference of two entries.
+        long long signed_volume = (change > 0) ? c.volume : (change < 0) ? -c.volume : 0;
+        cache.obv[i] = (i > 0 ? cache.obv[i-1] : 0) + signed_volume;
+        total_volume += c.volume;
+    }
+    cache.has_volume = cache.has_volume || total_volume > 0;
+    cache.timestamps.resize(n);
+    for (size_t i = old; i < n; ++i) cache.timestamps[i] = candles[i - old].timestamp;
+}
+// Fixed-fractional sizing: a trade stopped out at entry -/+ k*ATR loses risk_cash, so it holds
+// risk_lots[i] / k lots. The column depends only on the bar, so it is built once and the backtest pays a
+// divide and a round-down per entry, not per bar or per trial.
+void sizeSeries(SeriesCache& cache, double risk_cash, const InstrumentSpec& spec) {
+    cache.pip_value = spec.pip_value;
+    cache.lot_step = spec.lot_step;
+    cache.risk_lots.resize(cache.atr.size());
+    for (size_t i = 0; i < cache.atr.size(); ++i)
+        cache.risk_lots[i] = cache.atr[i] > 0 ? risk_cash / (cache.atr[i] * spec.pip_value) : 0.0;
+}
+// Down to the broker's lot step, so rounding never risks more than asked; 0 means even one step is too much.
+double roundLots(double lots, double lot_step) {
+    if (!(lots > 0)) return 0.0;
+    return lot_step > 0 ? std::floor(lots / lot_step + 1e-9) * lot_step : lots;
+}
 double simulateBacktest(const std::vector<Candle>& candles, const StrategyParams& params) {
-    if (candles.size() < std::max(params.sma_long, params.rsi_period) + 1) return -1e9;
-    std::vector<double> closes;
-    for(const auto& c : candles) closes.push_back(c.close);
-    double profit = 0.0;
-    bool in_pos = false;
-    double entry = 0.0;
-    size_t start = std::max(params.sma_long, params.rsi_period) + 1;
-    for (size_t i = start; i < candles.size(); ++i) {
-        double s_sma = computeSMA(closes, i, params.sma_short);
-        double l_sma = computeSMA(closes, i, params.sma_long);
-        double rsi = computeRSI(closes, i, params.rsi_period);
-        if (!in_pos && s_sma > l_sma && rsi > 50) { in_pos = true; entry = closes[i]; }
-        else if (in_pos && s_sma < l_sma) { profit += (closes[i] - entry); in_pos = false; }
-    }
-    return profit;
+    BacktestMetrics m = simulateBacktestRange(buildSeriesCache(candles), params, 0, candles.size());
+    return m.valid ? m.profit : -1e9;
+}
+size_t warmupBars(const StrategyParams& params) {
+    if (params.strategy != StrategyKind::SmaRsiObv) return params.channel_period + 1;
+    return std::max({params.sma_long, params.rsi_period, params.obv_period}) + 1;
+}
+// Largest warmup any candidate in the search space can need: every dimension at the top of its range,
+// and the periods the custom rules reach with those parameters.
+size_t maxWarmupBars(const std::vector<ParamRange>& space, StrategyKind kind, const RuleSet& rules) {
+    StrategyParams p = decodeParams(space, std::vector<double>(space.size(), 1.0), kind);
+    size_t warmup = warmupBars(p);
+    if (rules.custom) warmup = std::max(warmup, (size_t)std::max(compileRule(rules.buy, p, true).max_period, compileRule(rules.exit, p, true).max_period) + 1);
+    return warmup;
+}
+std::string describeParams(const StrategyParams& p) {
+    std::stringstream ss;
+    if (p.strategy == StrategyKind::Breakout) {
+        ss << "Breakout(" << p.channel_period << "/" << std::max(2, p.channel_period / 2) << "), SL/TP=" << p.sl_atr << "/" << p.tp_atr << "xATR, ATR%>" << p.min_atr_percent;
+        return ss.str();
+    }
+    if (p.strategy == StrategyKind::MeanReversion) {
+        ss << "MeanRev(SMA" << p.channel_period << " -" << p.band_k << "sd), SL/TP=" << p.sl_atr << "/" << p.tp_atr << "xATR, ATR%>" << p.min_atr_percent;
+        return ss.str();
+    }
+    ss << "SMA(" << p.sma_short << "/" << p.sma_long << "), RSI(" << p.rsi_period << ">" << p.rsi_threshold << "), OBV(" << p.obv_period
+       << "), SL/TP=" << p.sl_atr << "/" << p.tp_atr << "xATR, ATR%>" << p.min_atr_percent;
+    return ss.str();
+}
+// Strategy interface, resolved at compile time so each strategy gets its own fully inlined bar loop.
+// Derived provides:
+//   static std::vector<ParamRange> param_space();                 search space (names decodeParams knows)
+//   void prepare(cache, params, begin, end);                      per-trial setup before the bar loop
+//   size_t warmup() const;  bool enter(size_t i) const;  bool exit(size_t i) const;
+//   int signal(size_t i) const;                                   live direction at bar i (+1/-1/0)
+template <class Derived>
+struct Strategy {
+    const Derived& self() const { return static_cast<const Derived&>(*this); }
+    bool on_bar(size_t i, bool in_position) const { return in_position ? self().exit(i) : self().enter(i); }
+    int signal(size_t i) const { return self().enter(i) ? 1 : 0; }
+};
+// Long-only backtest: enter on the strategy's entry condition (plus the ATR% and higher-timeframe gates), leave on its exit
+// condition or the ATR-scaled stop loss / take profit; the stop is assumed hit first if a bar touches
+// both. Only bars in [begin, end) are used. Every metric is accumulated in this one pass; per-bar
+// returns are close-to-close while holding, drawdown is on realised + open profit. Profit is per unit of
+// price, or in account currency when the cache carries a sizing column (an entry too small for one lot
+// step is skipped). equity (if given) receives realised profit after each traded bar and trades (if
+// given) the profit of each closed trade.
+template <class S>
+void runBacktestBars(const SeriesCache& cache, const StrategyParams& params, const S& strategy, size_t from, size_t to, BacktestState& state, std::vector<double>* equity, std::vector<double>* trades);
+template <class S>
+BacktestMetrics runBacktestLoop(const SeriesCache& cache, const StrategyParams& params, const S& strategy, size_t begin, size_t end, std::vector<double>* equity, std::vector<double>* trades) {
+    size_t warmup = strategy.warmup();
+    if (end < begin + warmup) return BacktestMetrics();
+    BacktestState state;
+    runBacktestBars(cache, params, strategy, begin + warmup, end, state, equity, trades);
+    state.m.valid = true;
+    state.m.bars = end - begin - warmup;
+    state.m.profit = state.profit;
+    return state.m;
+}
+// The bar loop itself, over [from, to) and picking up from `state` (a fresh one, or where the previous
+// block of a streamed series stopped). The state is copied into locals for the loop and back after it.
+template <class S>
+void runBacktestBars(const SeriesCache& cache, const StrategyParams& params, const S& strategy, size_t from, size_t to, BacktestState& state, std::vector<double>* equity, std::vector<double>* trades) {
+    BacktestMetrics m = state.m;
+    const double* closes = cache.closes.data();
+    const double* highs = cache.highs.data();
+    const double* lows = cache.lows.data();
+    const double* atr = cache.atr.data();
+    const float* atr_percent = cache.atr_percent.data();
+    const float min_atr = params.min_atr_percent;
+    const int8_t* trend = cache.htf_trend.empty() ? nullptr : cache.htf_trend.data();
+    const double* risk_lots = cache.risk_lots.empty() ? nullptr : cache.risk_lots.data();
+    double profit = state.profit, peak = state.peak;
+    bool in_pos = state.in_pos;
+    double entry = state.entry, sl = state.sl, tp = state.tp, units = state.units;
+    for (size_t i = from; i < to; ++i) {
+        double ret = 0.0;
+        if (in_pos) {
+            m.exposure_bars++;
+            double exit_price = closes[i];
+            bool exit = true;
+            if (lows[i] <= sl) exit_price = sl;
+            else if (highs[i] >= tp) exit_price = tp;
+            else exit = strategy.on_bar(i, true);
+            ret = (exit_price - closes[i-1]) / closes[i-1];
+            if (exit) {
+                double pnl = (exit_price - entry) * units;
+                profit += pnl;
+                in_pos = false;
+                m.trades++;
+                if (pnl > 0) { m.wins++; m.gross_profit += pnl; } else m.gross_loss -= pnl;
+                if (trades) trades->push_back(pnl);
+            }
+        } else if (atr_percent[i] > min_atr && (!trend || trend[i] > 0) && strategy.on_bar(i, false)) {
+            if (risk_lots) units = roundLots(risk_lots[i] / params.sl_atr, cache.lot_step) * cache.pip_value;
+            in_pos = units > 0;
+            entry = closes[i];
+            sl = entry - params.sl_atr * atr[i];
+            tp = entry + params.tp_atr * atr[i];
+        }
+        m.ret_sum += ret;
+        m.ret_sq_sum += ret * ret;
+        if (ret < 0) m.down_sq_sum += ret * ret;
+
+        double marked = profit + (in_pos ? (closes[i] - entry) * units : 0.0);
+        peak = std::max(peak, marked);
+        m.max_drawdown = std::max(m.max_drawdown, peak - marked);
+        if (equity) equity->push_back(profit);
+    }
+    state = {m, profit, peak, in_pos, entry, sl, tp, units};
+}
+// The original SMA crossover + RSI + OBV strategy, i.e. the default RuleSet written out by hand; the
+// optimiser runs this fused form unless conf.txt overrides a rule. UseVolume is the cache's has_volume,
+// hoisted out of the bar loop.
+template <bool UseVolume>
+struct SmaRsiObvStrategy : Strategy<SmaRsiObvStrategy<UseVolume>> {
+    const double* sums = nullptr; const double* gains = nullptr; const double* losses = nullptr; const long long* obv = nullptr;
+    int s_p = 0, l_p = 0, r_p = 0, o_p = 0; double rsi_threshold = 0; size_t warmup_bars = 0;
+    static std::vector<ParamRange> param_space() {
+        // sma_long is searched as an offset from sma_short so every candidate is valid.
+        return { {"sma_short", 5, 15, true}, {"sma_long_diff", 5, 30, true}, {"rsi_period", 7, 21, true},
+                 {"sl_atr", 1.0, 3.0, false}, {"tp_atr", 1.0, 4.0, false}, {"obv_period", 5, 30, true},
+                 {"min_atr_percent", 0.05, 0.20, false}, {"rsi_threshold", 45, 60, false} };
+    }
+    void prepare(const SeriesCache& cache, const StrategyParams& params, size_t, size_t) {
+        sums = cache.close_sum.data(); gains = cache.gain_sum.data(); losses = cache.loss_sum.data(); obv = cache.obv.data();
+        s_p = params.sma_short; l_p = params.sma_long; r_p = params.rsi_period; o_p = params.obv_period;
+        rsi_threshold = params.rsi_threshold;
+        warmup_bars = warmupBars(params);
+    }
+    size_t warmup() const { return warmup_bars; }
+    double sma(size_t i, int p) const { return (sums[i+1] - sums[i+1-p]) / p; }
+    bool enter(size_t i) const {
+        if (!(sma(i, s_p) > sma(i, l_p))) return false;
+        if (UseVolume && !(obv[i] > obv[i+1-o_p])) return false;
+        // RSI last: it is the most expensive term.
+        double loss = losses[i+1] - losses[i+1-r_p];
+        double rsi = (loss == 0) ? 100.0 : 100.0 - (100.0 / (1.0 + (gains[i+1] - gains[i+1-r_p]) / loss));
+        return rsi > rsi_threshold;
+    }
+    bool exit(size_t i) const { return sma(i, s_p) < sma(i, l_p); }
+};
+// Custom rules from conf.txt, compiled for this trial's parameters and run on the bytecode VM.
+struct CompiledRules : Strategy<CompiledRules> {
+    const SeriesCache* cache = nullptr; const RuleSet* rules; RuleProgram entry; RuleProgram exit_rule; size_t warmup_bars = 0;
+    explicit CompiledRules(const RuleSet& r) : rules(&r) {}
+    void prepare(const SeriesCache& c, const StrategyParams& params, size_t, size_t) {
+        cache = &c;
+        entry = compileRule(rules->buy, params, c.has_volume);
+        exit_rule = compileRule(rules->exit, params, c.has_volume);
+        warmup_bars = std::max(warmupBars(params), (size_t)std::max(entry.max_period, exit_rule.max_period) + 1);
+    }
+    size_t warmup() const { return warmup_bars; }
+    bool enter(size_t i) const { return evalRule(entry, *cache, i) != 0; }
+    bool exit(size_t i) const { return evalRule(exit_rule, *cache, i) != 0; }
+};
+// Donchian breakout: enter when the close clears the highest high of the previous channel_period bars,
+// leave when it drops under the lowest low of the previous channel_period/2 bars.
+struct BreakoutStrategy : Strategy<BreakoutStrategy> {
+    const double* closes = nullptr; const double* highs = nullptr; const double* lows = nullptr;
+    std::vector<double> upper; std::vector<double> lower;  // indexed from begin
+    size_t base = 0; int period = 0; int exit_period = 0;
+    static std::vector<ParamRange> param_space() {
+        return { {"channel_period", 10, 60, true}, {"sl_atr", 1.0, 3.0, false}, {"tp_atr", 1.0, 4.0, false},
+                 {"min_atr_percent", 0.05, 0.20, false} };
+    }
+    // out[i - begin] = extreme of x over [i - window, i), O(n) for any window and branch-free (van Herk /
+    // Gil-Werman): with blocks of `window` bars, each window is the suffix extreme of one block combined
+    // with the prefix extreme of the next.
+    template <class Pick>
+    static void rollingExtreme(const double* x, size_t begin, size_t end, int window, Pick pick, std::vector<double>& out) {
+        size_t first = begin >= (size_t)window ? begin - window : 0, n = end - first, w = window;
+        std::vector<double> prefix(n), suffix(n);
+        for (size_t k = 0; k < n; ++k) prefix[k] = (k % w == 0) ? x[first + k] : pick(prefix[k-1], x[first + k]);
+        for (size_t k = n; k-- > 0;) suffix[k] = (k + 1 == n || (k + 1) % w == 0) ? x[first + k] : pick(suffix[k+1], x[first + k]);
+        out.assign(end - begin, 0.0);
+        for (size_t j = std::max(begin, first + w); j < end; ++j) out[j - begin] = pick(suffix[j - first - w], prefix[j - first - 1]);
+    }
+    void prepare(const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end) {
+        closes = cache.closes.data(); highs = cache.highs.data(); lows = cache.lows.data();
+        base = begin; period = params.channel_period; exit_period = std::max(2, period / 2);
+        rollingExtreme(highs, begin, end, period, [](double a, double b) { return std::max(a, b); }, upper);
+        rollingExtreme(lows, begin, end, exit_period, [](double a, double b) { return std::min(a, b); }, lower);
+    }
+    size_t warmup() const { return period + 1; }
+    bool enter(size_t i) const { return closes[i] > upper[i - base]; }
+    bool exit(size_t i) const { return closes[i] < lower[i - base]; }
+    int signal(size_t i) const {
+        if (enter(i)) return 1;
+        double lowest = lows[i-1];
+        for (size_t j = i - period; j < i; ++j) lowest = std::min(lowest, lows[j]);
+        return closes[i] < lowest ? -1 : 0;
+    }
+};
+// Mean reversion: buy a close more than band_k standard deviations under its channel_period SMA and
+// sell it back at the mean.
+struct MeanReversionStrategy : Strategy<MeanReversionStrategy> {
+    const double* closes = nullptr; const double* sums = nullptr; const double* sq_sums = nullptr;
+    double center = 0; int period = 0; double k = 0;
+    static std::vector<ParamRange> param_space() {
+        return { {"channel_period", 10, 50, true}, {"band_k", 1.0, 3.0, false}, {"sl_atr", 1.0, 3.0, false},
+                 {"tp_atr", 1.0, 4.0, false}, {"min_atr_percent", 0.05, 0.20, false} };
+    }
+    void prepare(const SeriesCache& cache, const StrategyParams& params, size_t, size_t) {
+        closes = cache.closes.data(); sums = cache.close_sum.data(); sq_sums = cache.centered_sq_sum.data();
+        center = cache.center; period = params.channel_period; k = params.band_k;
+    }
+    size_t warmup() const { return period + 1; }
+    double mean(size_t i) const { return (sums[i+1] - sums[i+1-period]) / period; }
+    // Deviation of the close from the mean, in standard deviations (variance from centred prefix sums).
+    double zscore(size_t i) const {
+        double m = mean(i), mc = m - center;
+        double var = (sq_sums[i+1] - sq_sums[i+1-period]) / period - mc * mc;
+        return var > 0 ? (closes[i] - m) / std::sqrt(var) : 0.0;
+    }
+    bool enter(size_t i) const { return zscore(i) < -k; }
+    bool exit(size_t i) const { return closes[i] >= mean(i); }
+    int signal(size_t i) const { double z = zscore(i); return z < -k ? 1 : z > k ? -1 : 0; }
+};
+std::vector<ParamRange> strategyParamSpace(StrategyKind kind) {
+    switch (kind) {
+        case StrategyKind::Breakout: return BreakoutStrategy::param_space();
+        case StrategyKind::MeanReversion: return MeanReversionStrategy::param_space();
+        default: return SmaRsiObvStrategy<true>::param_space();
+    }
+}
+template <class S>
+BacktestMetrics runStrategy(S strategy, const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end, std::vector<double>* equity, std::vector<double>* trades) {
+    strategy.prepare(cache, params, begin, end);
+    return runBacktestLoop(cache, params, strategy, begin, end, equity, trades);
+}
+template <bool UseVolume>
+BacktestMetrics backtestKernel(const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end, std::vector<double>* equity, std::vector<double>* trades) {
+    return runStrategy(SmaRsiObvStrategy<UseVolume>(), cache, params, begin, end, equity, trades);
+}
+// One switch per trial picks the strategy; the bar loop itself never dispatches.
+BacktestMetrics simulateBacktestRange(const SeriesCache& cache, const StrategyParams& params, size_t begin, size_t end, std::vector<double>* equity, std::vector<double>* trades, const RuleSet* rules) {
+    if (params.strategy == StrategyKind::Breakout) return runStrategy(BreakoutStrategy(), cache, params, begin, end, equity, trades);
+    if (params.strategy == StrategyKind::MeanReversion) return runStrategy(MeanReversionStrategy(), cache, params, begin, end, equity, trades);
+    if (rules && rules->custom) return runStrategy(CompiledRules(*rules), cache, params, begin, end, equity, trades);
+    return cache.has_volume ? backtestKernel<true>(cache, params, begin, end, equity, trades)
+                            : backtestKernel<false>(cache, params, begin, end, equity, trades);
+}
+// Block reader over a CSV too large to hold: each call parses the next `rows` lines (or what is left)
+// with the same row parser and statistics as readData, carrying the ordering checks across blocks.
+// Nothing is sorted or de-duplicated here; stats.out_of_order says whether that would have been needed.
+bool openCsvStream(CsvStream& in, const std::string& file, int64_t step) {
+    in.file.open(file, std::ios::binary);
+    if (!in.file) return false;
+    in.stats.step = step;
+    std::string header;
+    getline(in.file, header);
+    return true;
+}
+bool readCsvBlock(CsvStream& in, size_t rows, std::vector<Candle>& out) {
+    const size_t READ_BYTES = 1 << 20;
+    out.clear();
+    // Find the end of the rows-th line, topping the buffer up from the file as needed.
+    size_t cut = in.pos, lines = 0;
+    while (lines < rows) {
+        const char* nl = cut < in.buffer.size() ? (const char*)memchr(in.buffer.data() + cut, '\n', in.buffer.size() - cut) : nullptr;
+        if (nl) { cut = nl - in.buffer.data() + 1; lines++; continue; }
+        if (!in.file) { cut = in.buffer.size(); break; }
+        in.buffer.erase(0, in.pos);
+        cut -= in.pos;
+        in.pos = 0;
+        size_t had = in.buffer.size();
+        in.buffer.resize(had + READ_BYTES);
+        in.file.read(&in.buffer[had], READ_BYTES);
+        in.buffer.resize(had + in.file.gcount());
+    }
+    if (cut == in.pos) return false;
+    CsvChunk chunk;
+    chunk.begin = in.buffer.data() + in.pos;
+    chunk.end = in.buffer.data() + cut;
+    parseCsvChunk(chunk, in.stats.step);
+    mergeChunkStats(in.stats, chunk, in.last_time, in.repeated);
+    if (in.stats.first_time < 0 && !chunk.candles.empty()) in.stats.first_time = chunk.candles.front().timestamp;
+    if (!chunk.candles.empty()) in.stats.last_time = chunk.candles.back().timestamp;
+    out = std::move(chunk.candles);
+    in.pos = cut;
+    return true;
+}
+// Only the last `tail` rows of a file, read block by block so the rest never sits in memory; stats
+// cover the whole file.
+std::vector<Candle> streamTail(const std::string& file, size_t tail, size_t block_rows, SeriesStats* stats) {
+    CsvStream in;
+    std::vector<Candle> kept, block;
+    if (!openCsvStream(in, file, stats ? stats->step : 0)) return kept;
+    while (readCsvBlock(in, block_rows, block)) {
+        std::move(block.begin(), block.end(), std::back_inserter(kept));
+        if (kept.size() > 2 * tail) kept.erase(kept.begin(), kept.end() - tail);
+    }
+    if (kept.size() > tail) kept.erase(kept.begin(), kept.end() - tail);
+    if (stats) *stats = in.stats;
+    return kept;
+}
+// Drops the newest bar, so a bar that changed can be appended again.
+void popSeriesCache(SeriesCache& cache) {
+    size_t n = cache.closes.size();
+    if (n == 0) return;
+    for (auto* v : {&cache.closes, &cache.highs, &cache.lows, &cache.atr}) v->resize(n - 1);
+    for (auto* v : {&cache.close_sum, &cache.gain_sum, &cache.loss_sum, &cache.centered_sq_sum}) v->resize(n);
+    cache.atr_percent.resize(n - 1);
+    cache.obv.resize(n - 1);
+    cache.timestamps.resize(n - 1);
+}
+// Drops all but the last `keep` bars of a cache (prefix sums keep their running totals, so what is left
+// indexes exactly like the same bars of the full-length cache).
+void trimSeriesCache(SeriesCache& cache, size_t keep) {
+    size_t n = cache.closes.size();
+    if (n <= keep) return;
+    size_t drop = n - keep;
+    for (auto* v : {&cache.closes, &cache.highs, &cache.lows, &cache.atr, &cache.close_sum, &cache.gain_sum, &cache.loss_sum, &cache.centered_sq_sum})
+        v->erase(v->begin(), v->begin() + drop);
+    cache.atr_percent.erase(cache.atr_percent.begin(), cache.atr_percent.begin() + drop);
+    cache.obv.erase(cache.obv.begin(), cache.obv.begin() + drop);
+    cache.timestamps.erase(cache.timestamps.begin(), cache.timestamps.begin() + drop);
+}
+// The backtest of the whole file at `path`, as simulateBacktestRange(cache, params, 0, rows - 1) would
+// give it on the fully loaded file, bit for bit, but holding only a window of the strategy's lookback
+// plus one block. Each block is appended to the window, the strategy is prepared on the window, the
+// not-yet-run bars are run with the position and metrics carried over in BacktestState, and the window
+// is trimmed back to the lookback. The file's last bar (the live one) is never run, as in memory.
+template <class S>
+BacktestMetrics streamStrategy(const S& proto, const std::string& path, const StrategyParams& params, const StreamSettings& settings, std::vector<double>* trades, StreamReport* report) {
+    BacktestMetrics m;
+    CsvStream in;
+    if (!openCsvStream(in, path, 0)) return m;
+    SeriesCache window;
+    BacktestState state;
+    std::vector<Candle> block;
+    size_t offset = 0, next = 0, warmup = 0, rows = 0;  // offset: file index of window bar 0; next: first bar not yet run
+    bool first = true;
+    while (readCsvBlock(in, settings.block_rows, block)) {
+        rows += block.size();
+        appendSeriesCache(window, block);
+        if (window.closes.empty()) continue;
+        window.has_volume = settings.has_volume;
+        if (settings.risk_cash > 0) sizeSeries(window, settings.risk_cash, settings.spec);
+        S strategy = proto;
+        strategy.prepare(window, params, 0, window.closes.size());
+        if (first) { warmup = strategy.warmup(); next = warmup; first = false; }
+        size_t last = offset + window.closes.size() - 1;  // held back until a later block shows it is not the final bar
+        if (next < last) {
+            runBacktestBars(window, params, strategy, next - offset, last - offset, state, nullptr, trades);
+            next = last;
+        }
+        if (report) report->peak_bars = std::max(report->peak_bars, window.closes.size());
+        if (next > offset + warmup) {
+            size_t keep = offset + window.closes.size() - (next - warmup);
+            offset += window.closes.size() - keep;
+            trimSeriesCache(window, keep);
+        }
+    }
+    if (report) { report->rows = rows; report->stats = in.stats; }
+    if (rows < 1 || rows - 1 < warmup) return m;
+    m = state.m;
+    m.valid = true;
+    m.bars = rows - 1 - warmup;
+    m.profit = state.profit;
+    return m;
+}
+BacktestMetrics streamBacktest(const std::string& path, const StrategyParams& params, const RuleSet& rules, const StreamSettings& settings, std::vector<double>* trades, StreamReport* report) {
+    if (params.strategy == StrategyKind::Breakout) return streamStrategy(BreakoutStrategy(), path, params, settings, trades, report);
+    if (params.strategy == StrategyKind::MeanReversion) return streamStrategy(MeanReversionStrategy(), path, params, settings, trades, report);
+    if (rules.custom) return streamStrategy(CompiledRules(rules), path, params, settings, trades, report);
+    if (settings.has_volume) return streamStrategy(SmaRsiObvStrategy<true>(), path, params, settings, trades, report);
+    return streamStrategy(SmaRsiObvStrategy<false>(), path, params, settings, trades, report);
+}
+// The buy and sell rules compiled once for a ticker's parameters (obv() terms fold away without volume).
+LiveRules compileLiveRules(const RuleSet& rules, const StrategyParams& params, bool has_volume) {
+    return {compileRule(rules.buy, params, has_volume), compileRule(rules.sell, params, has_volume), has_volume};
+}
+// BUY/SELL/HOLD at bar i, before the volatility and trend gates. SmaRsiObv runs the same rule programs
+// the backtest does, compiled by compileLiveRules; the others their own rules.
+std::string liveSignal(const SeriesCache& cache, const StrategyParams& params, const LiveRules& programs, size_t i) {
+    if (params.strategy == StrategyKind::SmaRsiObv) {
+        if (i < (size_t)std::max(programs.buy.max_period, programs.sell.max_period)) return "HOLD";
+        if (evalRule(programs.buy, cache, i) != 0) return "BUY";
+        if (evalRule(programs.sell, cache, i) != 0) return "SELL";
+        return "HOLD";
+    }
+    int direction = strategySignal(cache, params, i);
+    return direction > 0 ? "BUY" : direction < 0 ? "SELL" : "HOLD";
+}
+// Live direction at bar i for the non-rule strategies (the SMA/RSI/OBV one goes through its RuleSet).
+int strategySignal(const SeriesCache& cache, const StrategyParams& params, size_t i) {
+    if (i < warmupBars(params)) return 0;
+    if (params.strategy == StrategyKind::Breakout) {
+        BreakoutStrategy s;
+        s.prepare(cache, params, i, i + 1);
+        return s.signal(i);
+    }
+    MeanReversionStrategy s;
+    s.prepare(cache, params, i, i + 1);
+    return s.signal(i);
+}
+// A strategy prepared over a whole series and type-erased, for callers that step several different
+// strategies side by side (the per-bar call is indirect, unlike the optimiser's inlined loops).
+using BarStep = std::function<bool(size_t, bool)>;
+template <class S>
+BarStep makeBarStep(S strategy, const SeriesCache& cache, const StrategyParams& params, size_t& warmup) {
+    strategy.prepare(cache, params, 0, cache.closes.size());
+    warmup = strategy.warmup();
+    auto shared = std::make_shared<S>(std::move(strategy));
+    return [shared](size_t i, bool in_position) { return shared->on_bar(i, in_position); };
+}
+BarStep strategyStep(const SeriesCache& cache, const StrategyParams& params, const RuleSet& rules, size_t& warmup) {
+    if (params.strategy == StrategyKind::Breakout) return makeBarStep(BreakoutStrategy(), cache, params, warmup);
+    if (params.strategy == StrategyKind::MeanReversion) return makeBarStep(MeanReversionStrategy(), cache, params, warmup);
+    if (rules.custom) return makeBarStep(CompiledRules(rules), cache, params, warmup);
+    if (cache.has_volume) return makeBarStep(SmaRsiObvStrategy<true>(), cache, params, warmup);
+    return makeBarStep(SmaRsiObvStrategy<false>(), cache, params, warmup);
+}
+// Merge-join of several sorted timestamp columns: step() runs once per distinct timestamp, in order, with
+// each column's cursor and whether it has a bar at that timestamp (different sessions and gaps just mean
+// a column sits a step out). The state is one cursor per column. include_last = false stops every column
+// before its final (live) bar; start (default: all zero) gives the first cursors and no step is later
+// than until.
+void mergeTimeline(const std::vector<const std::vector<int64_t>*>& columns, bool include_last, const std::function<void(const std::vector<size_t>&, const std::vector<char>&)>& step, const std::vector<size_t>& start, int64_t until) {
+    const int64_t DONE = INT64_MAX;
+    std::vector<size_t> cursor = start.empty() ? std::vector<size_t>(columns.size(), 0) : start;
+    std::vector<char> present(columns.size(), 0);
+    auto next_time = [&](size_t k) {
+        size_t end = columns[k]->size() - (include_last || columns[k]->empty() ? 0 : 1);
+        return cursor[k] < end && (*columns[k])[cursor[k]] <= until ? (*columns[k])[cursor[k]] : DONE;
+    };
+    while (true) {
+        int64_t now = DONE;
+        for (size_t k = 0; k < columns.size(); ++k) now = std::min(now, next_time(k));
+        if (now == DONE) break;
+        for (size_t k = 0; k < columns.size(); ++k) present[k] = next_time(k) == now;
+        step(cursor, present);
+        for (size_t k = 0; k < columns.size(); ++k) cursor[k] += present[k];
+    }
+}
+// All tickers traded together on one timeline (mergeTimeline over their timestamps).
+// Every ticker runs its optimised strategy with the same entry/exit rules as runBacktestLoop, but sized
+// from one shared account: a position puts up (marked-to-market) equity/tickers of margin for leverage
+// times that in notional, exits on a step free margin before entries use it, and an entry that does not
+// fit is refused.
+// State is a cursor and a position per ticker, so memory does not grow with history length.
+PortfolioSummary runPortfolio(const std::vector<TickerRun>& runs, const RunOptions& opts) {
+    struct Leg {
+        const TickerRun* run; BarStep step; size_t warmup = 0;
+        bool in_pos = false; bool exited = false; double entry = 0, sl = 0, tp = 0, units = 0, margin = 0, last_close = 0;
+    };
+    std::vector<Leg> legs;
+    for (const auto& r : runs) {
+        if (!r.ok || r.cache.closes.size() < 2) continue;
+        Leg leg;
+        leg.run = &r;
+        leg.step = strategyStep(r.cache, r.params, opts.rules, leg.warmup);
+        legs.push_back(std::move(leg));
+    }
+    PortfolioSummary pf;
+    pf.start_equity = pf.end_equity = opts.portfolio;
+    if (legs.empty()) return pf;
+
+    double cash = opts.portfolio, equity = opts.portfolio, peak = opts.portfolio, used_margin = 0;
+    int open_positions = 0;
+    std::vector<const std::vector<int64_t>*> columns;
+    for (const auto& l : legs) columns.push_back(&l.run->cache.timestamps);
+    // The last bar is the live one; like the per-ticker backtest, stop before it.
+    mergeTimeline(columns, false, [&](const std::vector<size_t>& cursor, const std::vector<char>& present) {
+        pf.steps++;
+        // Exits first, then entries, so margin released on this step can be reused.
+        for (int phase = 0; phase < 2; ++phase) {
+            for (size_t k = 0; k < legs.size(); ++k) {
+                if (!present[k]) continue;
+                Leg& l = legs[k];
+                const SeriesCache& c = l.run->cache;
+                const StrategyParams& p = l.run->params;
+                size_t i = cursor[k];
+                if (phase == 0) {
+                    l.last_close = c.closes[i];
+                    l.exited = false;
+                    if (!l.in_pos) continue;
+                    double exit_price = c.closes[i];
+                    bool exit = true;
+                    if (c.lows[i] <= l.sl) exit_price = l.sl;
+                    else if (c.highs[i] >= l.tp) exit_price = l.tp;
+                    else exit = l.step(i, true);
+                    if (exit) {
+                        cash += l.units * (exit_price - l.entry);
+                        used_margin -= l.margin;
+                        l.in_pos = false;
+                        l.exited = true;  // as in runBacktestLoop, no re-entry on the exit bar
+                        open_positions--;
+                        pf.trades++;
+                    }
+                } else {
+                    if (!l.in_pos && !l.exited && i >= l.warmup && c.atr_percent[i] > (float)p.min_atr_percent
+                        && (c.htf_trend.empty() || c.htf_trend[i] > 0) && l.step(i, false)) {
+                        double margin = std::max(0.0, equity) / legs.size();
+                        if (margin <= 0 || used_margin + margin > equity) {
+                            pf.refused++;
+                        } else {
+                            l.in_pos = true;
+                            l.entry = c.closes[i];
+                            l.sl = l.entry - p.sl_atr * c.atr[i];
+                            l.tp = l.entry + p.tp_atr * c.atr[i];
+                            l.margin = margin;
+                            l.units = margin * opts.leverage / l.entry;
+                            used_margin += margin;
+                            open_positions++;
+                        }
+                    }
+                }
+            }
+        }
+        equity = cash;
+        for (const auto& l : legs) if (l.in_pos) equity += l.units * (l.last_close - l.entry);
+        peak = std::max(peak, equity);
+        pf.max_drawdown = std::max(pf.max_drawdown, (peak - equity) / peak);
+        pf.peak_positions = std::max(pf.peak_positions, open_positions);
+        if (equity > 0) pf.peak_margin = std::max(pf.peak_margin, used_margin / equity);
+        pf.end_equity = equity;
+    });
+    return pf;
+}
+// Rolling Pearson correlation of T return series over the last `window` aligned bars. Each push adds
+// the new row and drops the oldest from running sums and sums of products, O(T^2) per bar with no
+// rescan of history; the inner loop is contiguous so the compiler vectorises it. To keep rounding drift
+// bounded the sums are rebuilt from the ring once per window, which is still O(T^2) per bar amortised.
+RollingCorrelation makeRollingCorrelation(size_t tickers, size_t window) {
+    RollingCorrelation rc;
+    rc.tickers = tickers;
+    rc.window = window;
+    rc.ring.assign(tickers * window, 0.0);
+    rc.sum.assign(tickers, 0.0);
+    rc.prod.assign(tickers * tickers, 0.0);
+    return rc;
+}
+void correlationPush(RollingCorrelation& rc, const double* returns) {
+    const size_t T = rc.tickers;
+    double* slot = &rc.ring[rc.head * T];
+    bool full = rc.count == rc.window;
+    for (size_t a = 0; a < T; ++a) {
+        double xa = returns[a], oa = full ? slot[a] : 0.0;
+        rc.sum[a] += xa - oa;
+        double* row = &rc.prod[a * T];
+        if (full) for (size_t b = 0; b < T; ++b) row[b] += xa * returns[b] - oa * slot[b];
+        else for (size_t b = 0; b < T; ++b) row[b] += xa * returns[b];
+    }
+    std::copy(returns, returns + T, slot);
+    rc.head = (rc.head + 1) % rc.window;
+    rc.count = std::min(rc.count + 1, rc.window);
+    if (++rc.since_rebuild == rc.window) {
+        rc.since_rebuild = 0;
+        std::fill(rc.sum.begin(), rc.sum.end(), 0.0);
+        std::fill(rc.prod.begin(), rc.prod.end(), 0.0);
+        for (size_t r = 0; r < rc.count; ++r) {
+            const double* x = &rc.ring[r * T];
+            for (size_t a = 0; a < T; ++a) {
+                rc.sum[a] += x[a];
+                for (size_t b = 0; b < T; ++b) rc.prod[a * T + b] += x[a] * x[b];
+            }
+        }
+    }
+}
+double correlationOf(const RollingCorrelation& rc, size_t a, size_t b) {
+    if (rc.count < 2) return 0.0;
+    const size_t T = rc.tickers;
+    double n = rc.count, ma = rc.sum[a] / n, mb = rc.sum[b] / n;
+    double cov = rc.prod[a * T + b] / n - ma * mb;
+    double va = rc.prod[a * T + a] / n - ma * ma, vb = rc.prod[b * T + b] / n - mb * mb;
+    return (va > 0 && vb > 0) ? cov / std::sqrt(va * vb) : 0.0;
+}
+// The timestamp just before the last `steps` distinct timestamps across the columns (INT64_MIN if there
+// are fewer), found by walking the merge backwards from the ends.
+int64_t timelineTailStart(const std::vector<const std::vector<int64_t>*>& columns, size_t steps) {
+    std::vector<size_t> cursor;
+    for (const auto* c : columns) cursor.push_back(c->size());
+    auto latest = [&]() {
+        int64_t t = INT64_MIN;
+        for (size_t k = 0; k < columns.size(); ++k)
+            if (cursor[k] > 0) t = std::max(t, (*columns[k])[cursor[k] - 1]);
+        return t;
+    };
+    for (size_t s = 0; s < steps; ++s) {
+        int64_t now = latest();
+        if (now == INT64_MIN) break;
+        for (size_t k = 0; k < columns.size(); ++k)
+            if (cursor[k] > 0 && (*columns[k])[cursor[k] - 1] == now) cursor[k]--;
+    }
+    return latest();
+}
+// Pushes the close-to-close returns of the members' aligned steps later than `after` and no later than
+// `until` (mergeTimeline; a ticker without a bar at a step contributes a zero return there). Returns the
+// last step pushed, or `after` if there was none.
+int64_t pushAlignedReturns(RollingCorrelation& rc, const std::vector<TickerRun>& runs, const std::vector<size_t>& members, int64_t after, int64_t until) {
+    std::vector<const std::vector<int64_t>*> columns;
+    std::vector<size_t> start;
+    for (size_t k : members) {
+        const std::vector<int64_t>& ts = runs[k].cache.timestamps;
+        columns.push_back(&ts);
+        start.push_back(std::upper_bound(ts.begin(), ts.end(), after) - ts.begin());
+    }
+    std::vector<double> returns(members.size());
+    int64_t last = after;
+    mergeTimeline(columns, true, [&](const std::vector<size_t>& cursor, const std::vector<char>& present) {
+        for (size_t t = 0; t < members.size(); ++t) {
+            const std::vector<double>& closes = runs[members[t]].cache.closes;
+            size_t i = cursor[t];
+            returns[t] = (present[t] && i > 0) ? closes[i] / closes[i-1] - 1.0 : 0.0;
+            if (present[t]) last = (*columns[t])[i];
+        }
+        correlationPush(rc, returns.data());
+    }, start, until);
+    return last;
+}
+// Drops live signals that duplicate exposure already taken: a BUY and a BUY on tickers whose recent
+// close-to-close returns correlate above the threshold, or a BUY and a SELL on ones that anti-correlate
+// (EURUSD long vs a USD-quoted cross short). Tickers are considered in dispatch order (priority, then
+// config order) and a signal survives only if it duplicates none that already survived. Only the last
+// corr_window + 1 aligned steps are pushed, so the cost does not grow with the history.
+void filterCorrelatedSignals(std::vector<TickerRun>& runs, const std::vector<PairConfig>& cfgs, const RunOptions& opts) {
+    std::vector<size_t> live;
+    for (size_t k = 0; k < runs.size(); ++k)
+        if (runs[k].ok && !runs[k].cache.closes.empty()) live.push_back(k);
+    std::vector<const std::vector<int64_t>*> columns;
+    for (size_t k : live) columns.push_back(&runs[k].cache.timestamps);
+    RollingCorrelation rc = makeRollingCorrelation(live.size(), opts.corr_window);
+    pushAlignedReturns(rc, runs, live, timelineTailStart(columns, opts.corr_window + 1), INT64_MAX);
+
+    std::vector<size_t> order(live.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return cfgs[live[a]].priority > cfgs[live[b]].priority; });
+    std::vector<size_t> kept;
+    for (size_t t : order) {
+        TickerRun& r = runs[live[t]];
+        if (r.signal == "HOLD") continue;
+        int dir = r.signal == "BUY" ? 1 : -1;
+        for (size_t u : kept) {
+            const TickerRun& other = runs[live[u]];
+            double rho = correlationOf(rc, t, u);
+            if (std::fabs(rho) >= opts.corr_filter && rho * dir * (other.signal == "BUY" ? 1 : -1) > 0) {
+                std::cout << "Correlation filter: dropped " << r.ticker << " " << r.signal << ", rho=" << rho << " with "
+                          << other.ticker << " " << other.signal << " over the last " << rc.count << " bars" << std::endl;
+                r.signal = "HOLD";
+                break;
+            }
+        }
+        if (r.signal != "HOLD") kept.push_back(t);
+    }
+}
+double sharpeRatio(const BacktestMetrics& m) {
+    if (m.bars < 2) return 0;
+    double mean = m.ret_sum / m.bars;
+    double var = m.ret_sq_sum / m.bars - mean * mean;
+    return var > 0 ? mean / std::sqrt(var) : 0;
+}
+double sortinoRatio(const BacktestMetrics& m) {
+    if (m.bars < 2) return 0;
+    double downside = std::sqrt(m.down_sq_sum / m.bars);
+    return downside > 0 ? (m.ret_sum / m.bars) / downside : 0;
+}
+// Per-bar ratios, not annualised; only their ordering matters to the optimiser.
+double objectiveValue(const BacktestMetrics& m, const std::string& objective) {
+    if (!m.valid) return -1e9;
+    if (objective == "sharpe") return sharpeRatio(m);
+    if (objective == "sortino") return sortinoRatio(m);
+    if (objective == "calmar") return m.max_drawdown > 0 ? m.profit / m.max_drawdown : m.profit;
+    return m.profit;
 }